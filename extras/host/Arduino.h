@@ -0,0 +1,76 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file Arduino.h
+ * @brief Minimal Arduino API for host builds
+ *
+ * Maps pins, interrupts and time onto the simulated bus of DaliSim.h, so the library
+ * sources can be compiled unchanged with -DDALI_HOST.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT  0x0
+#define OUTPUT 0x1
+
+#define CHANGE 1
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+/** Byte sink like Serial */
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t * buffer, size_t size) {
+      size_t count = 0;
+      while (size--)
+        count += write(*buffer++);
+      return count;
+    }
+};
@@ -0,0 +1,815 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "DaliSim.h"
+
+/*
+  Decoder
+*/
+
+void DaliSimDecoder::edge(bool new_level, uint64_t time) {
+  if (new_level == level) return;
+  level = new_level;
+  if (edgeCount == 0 && level) return; // rising edge outside of a frame
+  if (edgeCount < MAX_EDGES)
+    edges[edgeCount++] = time;
+  else
+    overflow = true;
+  lastEdge = time;
+}
+
+uint64_t DaliSimDecoder::nextEvent() const {
+  if (edgeCount == 0 || !level) return DALI_SIM_NEVER;
+  return lastEdge + 3 * DALI_SIM_TE; // frame is complete when bus is idle for more than 2 TE
+}
+
+bool DaliSimDecoder::levelAt(uint64_t time) const {
+  uint8_t count = 0;
+  while (count < edgeCount && edges[count] <= time)
+    count++;
+  return (count % 2) == 0;
+}
+
+int DaliSimDecoder::poll(uint64_t now, uint32_t & data, uint64_t & frameEnd) {
+  if (now < nextEvent()) return 0;
+
+  int bits = -1;
+  uint64_t t0 = edges[0];
+  uint32_t halves = (lastEdge - t0 + DALI_SIM_TE / 2) / DALI_SIM_TE;
+
+  // all edges need to be on half-bit boundaries
+  bool aligned = !overflow;
+  for (uint8_t i = 0; i < edgeCount && aligned; i++) {
+    uint32_t offset = (edges[i] - t0 + DALI_SIM_TE / 2) % DALI_SIM_TE;
+    aligned = (offset > DALI_SIM_TE / 2 - DALI_SIM_TE / 5) && (offset < DALI_SIM_TE / 2 + DALI_SIM_TE / 5);
+  }
+
+  if (aligned && halves >= 3 && halves <= 66 && !levelAt(t0 + DALI_SIM_TE / 2) && levelAt(t0 + 3 * DALI_SIM_TE / 2)) {
+    bits = (halves - 1) / 2;
+    data = 0;
+    for (int i = 0; i < bits; i++) {
+      bool first = levelAt(t0 + (4 * i + 5) * DALI_SIM_TE / 2);
+      bool second = levelAt(t0 + (4 * i + 7) * DALI_SIM_TE / 2);
+      if (first == second) {
+        bits = -1;
+        break;
+      }
+      data = (data << 1) | second;
+    }
+    frameEnd = t0 + (2 * bits + 2) * DALI_SIM_TE;
+  }
+
+  edgeCount = 0;
+  overflow = false;
+  return bits;
+}
+
+/*
+  Control gear
+*/
+
+DaliSimGear::DaliSimGear(uint8_t short_address, uint8_t device_type) {
+  static uint32_t serial = 0;
+  static const uint8_t bank0[27] = {
+    0x1A, 0x00, 0x01,                   // last accessible location, reserved, last accessible bank
+    0x04, 0x01, 0x23, 0x45, 0x67, 0x89, // GTIN
+    0x01, 0x00,                         // firmware version
+    0, 0, 0, 0, 0, 0, 0, 0,             // identification number, filled in below
+    0x02, 0x00,                         // hardware version
+    0x08, 0x08, 0xFF,                   // 101, 102 and 103 version
+    0x00, 0x01, 0x00                    // logical control devices, logical control gear, control gear index
+  };
+  memset(memory, 0, sizeof(memory));
+  memcpy(memory[0], bank0, sizeof(bank0));
+  serial++;
+  for (uint8_t i = 0; i < 4; i++)
+    memory[0][18 - i] = serial >> (8 * i);
+  memory[1][0] = 0x1F;
+  memory[1][2] = 0xFF; // locked
+  deviceType = device_type;
+  factoryReset(short_address);
+}
+
+void DaliSimGear::factoryReset(uint8_t short_address) {
+  shortAddress = short_address;
+  randomAddress = 0xFFFFFF;
+  searchAddress = 0xFFFFFF;
+  dtr0 = dtr1 = dtr2 = 0;
+  physMinLevel = 1;
+  minLevel = physMinLevel;
+  maxLevel = 254;
+  powerOnLevel = 254;
+  failLevel = 254;
+  actualLevel = lastActiveLevel = powerOnLevel;
+  fadeTime = 0;
+  fadeRate = 7;
+  for (uint8_t i = 0; i < 16; i++)
+    scenes[i] = 255;
+  groups = 0;
+  resetState = true;
+  initialised = false;
+  withdrawn = false;
+  repeatArmed = false;
+  enabledDeviceType = 0xFF;
+  colourTemperature = x = y = tempColourTemperature = tempX = tempY = 0xFFFF;
+  for (uint8_t i = 0; i < 6; i++)
+    rgbwaf[i] = tempRgbwaf[i] = 255;
+}
+
+void DaliSimGear::busChanged(bool level, uint64_t time) {
+  decoder.edge(level, time);
+}
+
+uint64_t DaliSimGear::nextEvent() const {
+  uint64_t next = decoder.nextEvent();
+  if (txStart != DALI_SIM_NEVER && txStart + txHalf * DALI_SIM_TE < next)
+    next = txStart + txHalf * DALI_SIM_TE;
+  return next;
+}
+
+void DaliSimGear::runEvents(uint64_t now) {
+  // backward frame transmission
+  while (txStart != DALI_SIM_NEVER && txStart + txHalf * DALI_SIM_TE <= now) {
+    if (txHalf < 18) {
+      bus->setPull(pull, !txHalves[txHalf++]);
+    } else {
+      bus->setPull(pull, false);
+      txStart = DALI_SIM_NEVER;
+    }
+  }
+
+  uint32_t data;
+  uint64_t frameEnd;
+  if (decoder.poll(now, data, frameEnd) == 16)
+    handleFrame(data, frameEnd);
+}
+
+bool DaliSimGear::isAddressed(uint8_t address) const {
+  if ((address & 0x80) == 0)            // short address 0AAAAAAS
+    return shortAddress == ((address >> 1) & 0x3F);
+  if ((address & 0xE0) == 0x80)         // group address 100AAAAS
+    return groups & (1 << ((address >> 1) & 0x0F));
+  if ((address & 0xFE) == 0xFE)         // broadcast
+    return true;
+  if ((address & 0xFE) == 0xFC)         // broadcast unaddressed
+    return shortAddress == 0xFF;
+  return false;
+}
+
+bool DaliSimGear::needsRepeat(uint16_t frame) const {
+  uint8_t address = frame >> 8;
+  uint8_t command = frame & 0xFF;
+  if (address == 0xA5 || address == 0xA7) // INITIALISE, RANDOMISE
+    return true;
+  if ((address & 0x01) == 0 || (address >= 0xA0 && address < 0xFC))
+    return false;
+  return command >= 32 && command <= 129;
+}
+
+void DaliSimGear::handleFrame(uint16_t frame, uint64_t frameEnd) {
+  uint8_t address = frame >> 8;
+  uint8_t data = frame & 0xFF;
+
+  // configuration commands are only executed when received twice within 100ms
+  if (repeatArmed && frame == repeatFrame && frameEnd - repeatTime <= 100000) {
+    repeatArmed = false;
+  } else if (needsRepeat(frame)) {
+    repeatArmed = true;
+    repeatFrame = frame;
+    repeatTime = frameEnd;
+    return;
+  } else {
+    repeatArmed = false;
+  }
+
+  // anything but DTR writes, memory access and ENABLE WRITE MEMORY itself disables writing memory
+  bool command = (address & 0x01) && (address < 0xA0 || address >= 0xFC);
+  if (!(command && (data == 129 || data == 197 || data == 152 || data == 156 || data == 157)) &&
+      address != 0xA3 && address != 0xC3 && address != 0xC5 && address != 0xC7 && address != 0xC9)
+    writeEnabled = false;
+
+  if (address >= 0xA0 && address < 0xCC && (address & 0x01)) {
+    handleSpecial(address, data, frameEnd);
+    return;
+  }
+
+  if (isAddressed(address)) {
+    framesReceived++;
+    if (address & 0x01)
+      handleCommand(data, frameEnd);
+    else if (data != 255) // 255 is MASK, keep level
+      setLevel(data);
+  }
+  enabledDeviceType = 0xFF;
+}
+
+void DaliSimGear::handleColourCommand(uint8_t command) {
+  switch (command) {
+    case 224: // SET TEMPORARY X-COORDINATE
+      tempX = dtr1 << 8 | dtr0;
+      break;
+    case 225: // SET TEMPORARY Y-COORDINATE
+      tempY = dtr1 << 8 | dtr0;
+      break;
+    case 226: // ACTIVATE, temporary values of 0xFFFF/255 (MASK) keep the current ones
+      if (tempColourTemperature != 0xFFFF) colourTemperature = tempColourTemperature;
+      if (tempX != 0xFFFF) x = tempX;
+      if (tempY != 0xFFFF) y = tempY;
+      for (uint8_t i = 0; i < 6; i++)
+        if (tempRgbwaf[i] != 255) rgbwaf[i] = tempRgbwaf[i];
+      tempColourTemperature = tempX = tempY = 0xFFFF;
+      for (uint8_t i = 0; i < 6; i++)
+        tempRgbwaf[i] = 255;
+      break;
+    case 231: // SET TEMPORARY COLOUR TEMPERATURE TC
+      tempColourTemperature = dtr1 << 8 | dtr0;
+      break;
+    case 235: // SET TEMPORARY RGB DIMLEVEL
+      tempRgbwaf[0] = dtr0;
+      tempRgbwaf[1] = dtr1;
+      tempRgbwaf[2] = dtr2;
+      break;
+    case 236: // SET TEMPORARY WAF DIMLEVEL
+      tempRgbwaf[3] = dtr0;
+      tempRgbwaf[4] = dtr1;
+      tempRgbwaf[5] = dtr2;
+      break;
+  }
+}
+
+void DaliSimGear::handleSpecial(uint8_t address, uint8_t data, uint64_t frameEnd) {
+  switch (address) {
+    case 0xA1: // TERMINATE
+      initialised = false;
+      break;
+    case 0xA3: // DTR0
+      dtr0 = data;
+      break;
+    case 0xA5: // INITIALISE
+      if (data == 0x00 || (data == 0xFF && shortAddress == 0xFF) || ((data & 0x81) == 0x01 && (data >> 1) == shortAddress)) {
+        initialised = true;
+        withdrawn = false;
+      }
+      break;
+    case 0xA7: // RANDOMISE
+      if (initialised)
+        randomAddress = DaliSim.random() & 0xFFFFFF;
+      break;
+    case 0xA9: // COMPARE
+      if (initialised && !withdrawn && randomAddress <= searchAddress)
+        reply(0xFF, frameEnd);
+      break;
+    case 0xAB: // WITHDRAW
+      if (initialised && randomAddress == searchAddress)
+        withdrawn = true;
+      break;
+    case 0xB1: // SEARCHADDRH
+      if (initialised)
+        searchAddress = (searchAddress & 0x00FFFF) | ((uint32_t)data << 16);
+      break;
+    case 0xB3: // SEARCHADDRM
+      if (initialised)
+        searchAddress = (searchAddress & 0xFF00FF) | ((uint32_t)data << 8);
+      break;
+    case 0xB5: // SEARCHADDRL
+      if (initialised)
+        searchAddress = (searchAddress & 0xFFFF00) | data;
+      break;
+    case 0xB7: // PROGRAM SHORT ADDRESS
+      if (initialised && randomAddress == searchAddress) {
+        if (data == 0xFF)
+          shortAddress = 0xFF;
+        else if ((data & 0x81) == 0x01)
+          shortAddress = data >> 1;
+      }
+      break;
+    case 0xB9: // VERIFY SHORT ADDRESS
+      if (initialised && (data & 0x81) == 0x01 && shortAddress == (data >> 1))
+        reply(0xFF, frameEnd);
+      break;
+    case 0xBB: // QUERY SHORT ADDRESS
+      if (initialised && randomAddress == searchAddress)
+        reply(shortAddress == 0xFF ? 0xFF : (shortAddress << 1) | 1, frameEnd);
+      break;
+    case 0xC1: // ENABLE DEVICE TYPE, applies to the next command only
+      enabledDeviceType = data;
+      return;
+    case 0xC3: // DTR1
+      dtr1 = data;
+      break;
+    case 0xC5: // DTR2
+      dtr2 = data;
+      break;
+    case 0xC7: // WRITE MEMORY LOCATION
+    case 0xC9: // WRITE MEMORY LOCATION - NO REPLY
+      writeMemory(data, address == 0xC7, frameEnd);
+      break;
+  }
+  enabledDeviceType = 0xFF;
+}
+
+void DaliSimGear::writeMemory(uint8_t value, bool answer, uint64_t frameEnd) {
+  if (!writeEnabled) return;
+  // bank 0 is read-only, locations of bank 1 other than the lock byte need it to be 0x55
+  if (dtr1 == 1 && dtr0 <= memory[1][0] && (dtr0 == 2 || (dtr0 > 2 && memory[1][2] == 0x55))) {
+    memory[1][dtr0] = value;
+    if (answer) reply(value, frameEnd);
+  }
+  if (dtr0 < 0xFF) dtr0++;
+}
+
+void DaliSimGear::setLevel(uint8_t level) {
+  if (level != 0) {
+    if (level < minLevel) level = minLevel;
+    if (level > maxLevel) level = maxLevel;
+    lastActiveLevel = level;
+  }
+  actualLevel = level;
+  powerCycleSeen = false;
+}
+
+void DaliSimGear::handleCommand(uint8_t command, uint64_t frameEnd) {
+  if (command >= 224) { // application extended commands, only the colour of DT8 is simulated
+    if (deviceType == 8 && enabledDeviceType == 8)
+      handleColourCommand(command);
+    return;
+  }
+
+  if (command >= 16 && command <= 31) { // GO TO SCENE
+    if (scenes[command - 16] != 255)
+      setLevel(scenes[command - 16]);
+    return;
+  }
+  if (command >= 64 && command <= 127) {
+    uint8_t n = command & 0x0F;
+    if (command < 80)       // SET SCENE
+      scenes[n] = dtr0;
+    else if (command < 96)  // REMOVE FROM SCENE
+      scenes[n] = 255;
+    else if (command < 112) // ADD TO GROUP
+      groups |= (1 << n);
+    else                    // REMOVE FROM GROUP
+      groups &= ~(1 << n);
+    resetState = false;
+    return;
+  }
+  if (command >= 176 && command <= 191) { // QUERY SCENE LEVEL
+    reply(scenes[command - 176], frameEnd);
+    return;
+  }
+
+  switch (command) {
+    case 0: // OFF
+      setLevel(0);
+      break;
+    case 1: // UP
+    case 3: // STEP UP
+      if (actualLevel != 0 && actualLevel < maxLevel)
+        setLevel(actualLevel + 1);
+      break;
+    case 2: // DOWN
+    case 4: // STEP DOWN
+      if (actualLevel > minLevel)
+        setLevel(actualLevel - 1);
+      break;
+    case 5: // RECALL MAX
+      setLevel(maxLevel);
+      break;
+    case 6: // RECALL MIN
+      setLevel(minLevel);
+      break;
+    case 7: // STEP DOWN AND OFF
+      if (actualLevel != 0)
+        setLevel(actualLevel <= minLevel ? 0 : actualLevel - 1);
+      break;
+    case 8: // ON AND STEP UP
+      setLevel(actualLevel == 0 ? minLevel : (actualLevel < maxLevel ? actualLevel + 1 : actualLevel));
+      break;
+    case 10: // GO TO LAST ACTIVE LEVEL
+      setLevel(lastActiveLevel);
+      break;
+    case 32: { // RESET
+      uint8_t address = shortAddress;
+      factoryReset(address);
+      break;
+    }
+    case 33: // STORE ACTUAL LEVEL IN DTR0
+      dtr0 = actualLevel;
+      break;
+    case 42: // DTR AS MAX LEVEL
+      maxLevel = dtr0 < minLevel ? minLevel : (dtr0 > 254 ? 254 : dtr0);
+      if (actualLevel > maxLevel)
+        setLevel(maxLevel);
+      resetState = false;
+      break;
+    case 43: // DTR AS MIN LEVEL
+      minLevel = dtr0 < physMinLevel ? physMinLevel : (dtr0 > maxLevel ? maxLevel : dtr0);
+      if (actualLevel != 0 && actualLevel < minLevel)
+        setLevel(minLevel);
+      resetState = false;
+      break;
+    case 44: // DTR AS SYSTEM FAILURE LEVEL
+      failLevel = dtr0;
+      resetState = false;
+      break;
+    case 45: // DTR AS POWER ON LEVEL
+      powerOnLevel = dtr0;
+      resetState = false;
+      break;
+    case 46: // DTR AS FADE TIME
+      fadeTime = dtr0 > 15 ? 15 : dtr0;
+      resetState = false;
+      break;
+    case 47: // DTR AS FADE RATE
+      fadeRate = dtr0 == 0 ? 1 : (dtr0 > 15 ? 15 : dtr0);
+      resetState = false;
+      break;
+    case 128: // DTR AS SHORT ADDRESS
+      if (dtr0 == 0xFF)
+        shortAddress = 0xFF;
+      else if ((dtr0 & 0x81) == 0x01)
+        shortAddress = dtr0 >> 1;
+      break;
+    case 129: // ENABLE WRITE MEMORY
+      writeEnabled = true;
+      break;
+
+    case 144: // QUERY STATUS
+      reply((gearFailure ? 0x01 : 0) | (lampFailure ? 0x02 : 0) | (actualLevel ? 0x04 : 0) |
+            (resetState ? 0x20 : 0) | (shortAddress == 0xFF ? 0x40 : 0) | (powerCycleSeen ? 0x80 : 0), frameEnd);
+      break;
+    case 145: // QUERY CONTROL GEAR PRESENT
+      reply(0xFF, frameEnd);
+      break;
+    case 146: // QUERY LAMP FAILURE
+      if (lampFailure) reply(0xFF, frameEnd);
+      break;
+    case 147: // QUERY LAMP POWER ON
+      if (actualLevel) reply(0xFF, frameEnd);
+      break;
+    case 149: // QUERY RESET STATE
+      if (resetState) reply(0xFF, frameEnd);
+      break;
+    case 150: // QUERY MISSING SHORT ADDRESS
+      if (shortAddress == 0xFF) reply(0xFF, frameEnd);
+      break;
+    case 151: // QUERY VERSION NUMBER
+      reply(0x08, frameEnd);
+      break;
+    case 152: // QUERY CONTENT DTR0
+      reply(dtr0, frameEnd);
+      break;
+    case 153: // QUERY DEVICE TYPE
+      reply(deviceType, frameEnd);
+      break;
+    case 154: // QUERY PHYSICAL MINIMUM
+      reply(physMinLevel, frameEnd);
+      break;
+    case 155: // QUERY POWER FAILURE
+      if (powerCycleSeen) reply(0xFF, frameEnd);
+      break;
+    case 156: // QUERY CONTENT DTR1
+      reply(dtr1, frameEnd);
+      break;
+    case 157: // QUERY CONTENT DTR2
+      reply(dtr2, frameEnd);
+      break;
+    case 158: // QUERY OPERATING MODE
+      reply(0, frameEnd);
+      break;
+    case 159: // QUERY LIGHT SOURCE TYPE
+      reply(6, frameEnd);
+      break;
+    case 160: // QUERY ACTUAL LEVEL
+      reply(actualLevel, frameEnd);
+      break;
+    case 161: // QUERY MAX LEVEL
+      reply(maxLevel, frameEnd);
+      break;
+    case 162: // QUERY MIN LEVEL
+      reply(minLevel, frameEnd);
+      break;
+    case 163: // QUERY POWER ON LEVEL
+      reply(powerOnLevel, frameEnd);
+      break;
+    case 164: // QUERY SYSTEM FAILURE LEVEL
+      reply(failLevel, frameEnd);
+      break;
+    case 165: // QUERY FADE TIME/FADE RATE
+      reply((fadeTime << 4) | fadeRate, frameEnd);
+      break;
+    case 168: // QUERY EXTENDED FADE TIME
+      reply(0, frameEnd);
+      break;
+    case 169: // QUERY CONTROL GEAR FAILURE
+      if (gearFailure) reply(0xFF, frameEnd);
+      break;
+    case 192: // QUERY GROUPS 0-7
+      reply(groups & 0xFF, frameEnd);
+      break;
+    case 193: // QUERY GROUPS 8-15
+      reply(groups >> 8, frameEnd);
+      break;
+    case 194: // QUERY RANDOM ADDRESS (H)
+      reply((randomAddress >> 16) & 0xFF, frameEnd);
+      break;
+    case 195: // QUERY RANDOM ADDRESS (M)
+      reply((randomAddress >> 8) & 0xFF, frameEnd);
+      break;
+    case 196: // QUERY RANDOM ADDRESS (L)
+      reply(randomAddress & 0xFF, frameEnd);
+      break;
+    case 197: // READ MEMORY LOCATION
+      if (dtr1 < 2 && dtr0 <= memory[dtr1][0]) {
+        reply(memory[dtr1][dtr0], frameEnd);
+        if (dtr0 < 0xFF) dtr0++;
+      }
+      break;
+  }
+}
+
+void DaliSimGear::reply(uint8_t value, uint64_t frameEnd) {
+  if (txStart != DALI_SIM_NEVER) return; // still busy with previous answer
+
+  uint8_t delay = replyDelay;
+  if (replyJitter)
+    delay += DaliSim.random() % (replyJitter + 1);
+  txStart = frameEnd + delay * DALI_SIM_TE;
+  txHalf = 0;
+
+  // start bit, then 8 bits MSB first, each as two half-bits (1 = low/high)
+  txHalves[0] = false;
+  txHalves[1] = true;
+  for (uint8_t i = 0; i < 8; i++) {
+    bool bit = value & (0x80 >> i);
+    txHalves[2 + 2 * i] = !bit;
+    txHalves[3 + 2 * i] = bit;
+  }
+  framesAnswered++;
+}
+
+/*
+  Bus
+*/
+
+void DaliSimBus::add(DaliSimGear & device) {
+  device.bus = this;
+  gear.push_back(&device);
+}
+
+void DaliSimBus::clear() {
+  for (DaliSimGear * device : gear) {
+    setPull(device->pull, false);
+    device->txStart = DALI_SIM_NEVER;
+    device->bus = nullptr;
+  }
+  gear.clear();
+}
+
+void DaliSimBus::setPull(bool & pull, bool value) {
+  if (pull == value) return;
+  pull = value;
+
+  bool before = level();
+  pullCount += value ? 1 : -1;
+  if (level() == before) return;
+
+  for (DaliSimGear * device : gear)
+    device->busChanged(level(), DaliSim.now);
+  monitor.edge(level(), DaliSim.now);
+  DaliSim.busChanged(this);
+}
+
+uint64_t DaliSimBus::nextEvent() const {
+  uint64_t next = monitor.nextEvent();
+  for (DaliSimGear * device : gear) {
+    uint64_t event = device->nextEvent();
+    if (event < next)
+      next = event;
+  }
+  return next;
+}
+
+void DaliSimBus::runEvents(uint64_t now) {
+  for (DaliSimGear * device : gear)
+    device->runEvents(now);
+
+  uint32_t data;
+  uint64_t frameEnd;
+  int bits = monitor.poll(now, data, frameEnd);
+  if (bits == 8)
+    backwardFrames++;
+  else if (bits == 16 || bits == 24 || bits == 25)
+    forwardFrames++;
+  else if (bits != 0)
+    errorFrames++;
+}
+
+/*
+  Clock, pins and interrupts
+*/
+
+DaliSimClass DaliSim;
+
+void DaliSimClass::connect(DaliSimBus & bus, uint8_t tx_pin, uint8_t rx_pin, bool active_low) {
+  pins[tx_pin].bus = &bus;
+  pins[tx_pin].isTx = true;
+  pins[tx_pin].activeLow = active_low;
+  pins[rx_pin].bus = &bus;
+  pins[rx_pin].isTx = false;
+  pins[rx_pin].activeLow = active_low;
+
+  for (DaliSimBus * known : buses)
+    if (known == &bus) return;
+  buses.push_back(&bus);
+}
+
+void DaliSimClass::run(uint64_t us) {
+  runUntil(now + us);
+}
+
+void DaliSimClass::runUntil(uint64_t time) {
+  while (true) {
+    uint64_t next = DALI_SIM_NEVER;
+    for (HostTimer * timer : timers)
+      if (timer->running && timer->next < next)
+        next = timer->next;
+    for (DaliSimBus * bus : buses) {
+      uint64_t event = bus->nextEvent();
+      if (event < next)
+        next = event;
+    }
+    if (next > time) break;
+    if (next > now)
+      now = next;
+
+    for (DaliSimBus * bus : buses)
+      bus->runEvents(now);
+
+    for (HostTimer * timer : timers) {
+      if (!timer->running || timer->next > now) continue;
+      timer->next += timer->period;
+      timer->ticks++;
+      inIsr = true;
+      timer->isr();
+      inIsr = false;
+      dispatch();
+    }
+  }
+  if (time > now)
+    now = time;
+}
+
+uint32_t DaliSimClass::random() {
+  // xorshift32
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+int DaliSimClass::pinRead(uint8_t pin) {
+  simPin & p = pins[pin];
+  if (p.bus == nullptr) return LOW;
+  return p.activeLow ? !p.bus->level() : p.bus->level();
+}
+
+void DaliSimClass::pinWrite(uint8_t pin, uint8_t value) {
+  simPin & p = pins[pin];
+  if (p.bus == nullptr || !p.isTx) return;
+  p.bus->setPull(p.pull, p.activeLow ? value != LOW : value == LOW);
+}
+
+void DaliSimClass::pinInterrupt(uint8_t pin, void (*isr)()) {
+  pins[pin].isr = isr;
+  pins[pin].pending = false;
+}
+
+void DaliSimClass::timerStart(HostTimer * timer) {
+  timer->next = now + timer->period;
+  timer->running = true;
+  for (HostTimer * known : timers)
+    if (known == timer) return;
+  timers.push_back(timer);
+}
+
+void DaliSimClass::busChanged(DaliSimBus * bus) {
+  for (simPin & p : pins)
+    if (p.bus == bus && !p.isTx && p.isr != nullptr)
+      p.pending = true;
+  if (!inIsr)
+    dispatch();
+}
+
+// run pending pin change interrupts, like the hardware does once the current ISR has returned
+void DaliSimClass::dispatch() {
+  bool found = true;
+  while (found) {
+    found = false;
+    for (simPin & p : pins) {
+      if (!p.pending) continue;
+      p.pending = false;
+      inIsr = true;
+      p.isr();
+      inIsr = false;
+      found = true;
+    }
+  }
+}
+
+/*
+  HostTimer
+*/
+
+bool HostTimer::attachInterrupt(float frequency, void (*callback)()) {
+  period = (uint32_t)(1000000.0f / frequency + 0.5f);
+  isr = callback;
+  DaliSim.timerStart(this);
+  return true;
+}
+
+void HostTimer::detachInterrupt() {
+  running = false;
+  isr = nullptr;
+}
+
+void HostTimer::restartTimer() {
+  next = DaliSim.now + period;
+  running = isr != nullptr;
+}
+
+void HostTimer::stopTimer() {
+  running = false;
+}
+
+/*
+  Arduino API
+*/
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+int digitalRead(uint8_t pin) {
+  return DaliSim.pinRead(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  DaliSim.pinWrite(pin, value);
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+  DaliSim.pinInterrupt(interrupt, isr);
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  DaliSim.pinInterrupt(interrupt, nullptr);
+}
+
+// interrupts never preempt the main loop in the simulation
+void noInterrupts() {}
+void interrupts() {}
+
+unsigned long micros() {
+  if (!DaliSim.inIsr)
+    DaliSim.run(DaliSim.loopTime);
+  return DaliSim.now;
+}
+
+unsigned long millis() {
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+  DaliSim.run((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (!DaliSim.inIsr)
+    DaliSim.run(us);
+}
+
+long random(long max) {
+  return max > 0 ? DaliSim.random() % max : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  DaliSim.seed(seed);
+}
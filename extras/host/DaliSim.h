@@ -0,0 +1,218 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliSim.h
+ * @brief Simulated DALI bus for host builds
+ *
+ * This file contains a virtual wired-AND DALI bus, a simulated clock and simulated control gear.
+ * Together with the Arduino.h and TimerInterrupt_Generic.h shims in this directory it allows running
+ * DaliBusClass and DaliClass unchanged on a Linux host, faster than real time.
+ *
+ * Time only advances when DaliSim.run() is called or when the main loop reads the clock through
+ * micros()/millis() (by DaliSimClass::loopTime each). Timer and pin change interrupts are executed
+ * from within the simulation, so interrupts never preempt the main loop in the middle of a statement.
+ */
+
+#include <stdint.h>
+#include <vector>
+
+#include "TimerInterrupt_Generic.h"
+
+const uint32_t DALI_SIM_TE = 417;
+const uint64_t DALI_SIM_NEVER = UINT64_MAX;
+
+class DaliSimBus;
+
+/** Manchester decoder watching a simulated bus */
+class DaliSimDecoder {
+  public:
+    /** Feed bus level change */
+    void edge(bool level, uint64_t time);
+
+    /** Time at which the current frame is complete, DALI_SIM_NEVER if no frame is in progress */
+    uint64_t nextEvent() const;
+
+    /** Decode frame if complete
+      * @param now       current time
+      * @param data      receives frame content, right-aligned
+      * @param frameEnd  receives the time at which the last bit ended
+      * @return number of bits, 0 if no frame is complete or -1 on a garbled frame */
+    int poll(uint64_t now, uint32_t & data, uint64_t & frameEnd);
+
+  protected:
+    static const uint8_t MAX_EDGES = 64;
+    uint64_t edges[MAX_EDGES]; // first edge is falling, levels alternate from there
+    uint8_t edgeCount = 0;
+    uint64_t lastEdge = 0;
+    bool overflow = false;
+    bool level = true;
+
+    bool levelAt(uint64_t time) const;
+};
+
+/** Simulated DALI control gear (IEC 62386-102) */
+class DaliSimGear {
+  public:
+    DaliSimGear(uint8_t short_address = 0xFF, uint8_t device_type = 6);
+
+    /** Restore factory state (keeps #replyDelay and #replyJitter) */
+    void factoryReset(uint8_t short_address = 0xFF);
+
+    uint8_t replyDelay = 14;  /**< TE between the end of a forward frame and the backward frame */
+    uint8_t replyJitter = 0;  /**< random extra reply delay in TE, 0 to this value */
+
+    uint8_t shortAddress;     /**< 0xFF if none */
+    uint32_t randomAddress;
+    uint32_t searchAddress;
+    uint8_t dtr0, dtr1, dtr2;
+    uint8_t actualLevel, lastActiveLevel;
+    uint8_t physMinLevel, minLevel, maxLevel, powerOnLevel, failLevel;
+    uint8_t fadeTime, fadeRate;
+    uint8_t scenes[16];
+    uint16_t groups;
+    uint8_t deviceType;
+    bool lampFailure = false;
+    bool gearFailure = false;
+    bool resetState;
+    bool powerCycleSeen = true;
+
+    /** DT8 colour, 0xFFFF/255 if never set (device type 8 only) */
+    uint16_t colourTemperature, x, y;
+    uint8_t rgbwaf[6];
+
+    /** memory banks 0 (read-only) and 1, location 0 holds the last accessible location. Not changed by
+      * factoryReset(), bank 0 gets a serial number unique to each instance. */
+    uint8_t memory[2][32];
+
+    uint32_t framesReceived = 0; /**< forward frames addressed to this gear */
+    uint32_t framesAnswered = 0; /**< backward frames sent */
+
+  protected:
+    friend class DaliSimBus;
+
+    DaliSimBus * bus = nullptr;
+    DaliSimDecoder decoder;
+    bool pull = false;
+
+    bool initialised = false;
+    bool withdrawn = false;
+    uint16_t repeatFrame = 0;
+    uint64_t repeatTime = 0;
+    bool repeatArmed = false;
+    uint8_t enabledDeviceType = 0xFF;
+    bool writeEnabled = false; // ENABLE WRITE MEMORY, until any other than the memory related frames
+    uint16_t tempColourTemperature, tempX, tempY; // DT8 temporary colour, taken over by ACTIVATE
+    uint8_t tempRgbwaf[6];
+
+    uint64_t txStart = DALI_SIM_NEVER;
+    uint8_t txHalf;
+    bool txHalves[18];
+
+    void busChanged(bool level, uint64_t time);
+    uint64_t nextEvent() const;
+    void runEvents(uint64_t now);
+
+    void handleFrame(uint16_t frame, uint64_t frameEnd);
+    void handleSpecial(uint8_t address, uint8_t data, uint64_t frameEnd);
+    void handleCommand(uint8_t command, uint64_t frameEnd);
+    void handleColourCommand(uint8_t command);
+    void writeMemory(uint8_t value, bool answer, uint64_t frameEnd);
+    bool isAddressed(uint8_t address) const;
+    bool needsRepeat(uint16_t frame) const;
+    void setLevel(uint8_t level);
+    void reply(uint8_t value, uint64_t frameEnd);
+};
+
+/** Virtual wired-AND DALI bus */
+class DaliSimBus {
+  public:
+    /** Attach control gear */
+    void add(DaliSimGear & gear);
+
+    /** Detach all control gear */
+    void clear();
+
+    /** current bus level, HIGH (idle) unless anyone pulls it low */
+    bool level() const { return pullCount == 0; }
+
+    std::vector<DaliSimGear *> gear;
+
+    uint32_t forwardFrames = 0;  /**< 16, 24 and 25 bit frames seen on the bus */
+    uint32_t backwardFrames = 0; /**< 8 bit frames seen on the bus */
+    uint32_t errorFrames = 0;    /**< garbled frames, e.g. colliding backward frames */
+
+  protected:
+    friend class DaliSimClass;
+    friend class DaliSimGear;
+
+    uint16_t pullCount = 0;
+    DaliSimDecoder monitor;
+
+    void setPull(bool & pull, bool value);
+    uint64_t nextEvent() const;
+    void runEvents(uint64_t now);
+};
+
+/** Simulated clock, pins and interrupts */
+class DaliSimClass {
+  public:
+    /** Connect a bus interface to @p bus
+      * @param active_low  polarity of the interface, see DaliBusClass::begin() */
+    void connect(DaliSimBus & bus, uint8_t tx_pin, uint8_t rx_pin, bool active_low = true);
+
+    /** Advance simulated time by @p us */
+    void run(uint64_t us);
+
+    /** Advance simulated time up to @p time */
+    void runUntil(uint64_t time);
+
+    /** Pseudo random number, deterministic for a given seed */
+    uint32_t random();
+    void seed(uint32_t value) { rng = value ? value : 1; }
+
+    uint64_t now = 0;       /**< simulated time in µs */
+    uint32_t loopTime = 10; /**< µs the clock advances on each micros()/millis() call from the main loop */
+
+    // used by the shims
+    int pinRead(uint8_t pin);
+    void pinWrite(uint8_t pin, uint8_t value);
+    void pinInterrupt(uint8_t pin, void (*isr)());
+    void timerStart(HostTimer * timer);
+    void busChanged(DaliSimBus * bus);
+    bool inIsr = false;
+
+  protected:
+    struct simPin {
+      DaliSimBus * bus = nullptr;
+      bool isTx = false;
+      bool activeLow = true;
+      bool pull = false;
+      void (*isr)() = nullptr;
+      bool pending = false;
+    };
+    simPin pins[256];
+    std::vector<DaliSimBus *> buses;
+    std::vector<HostTimer *> timers;
+    uint32_t rng = 0x2545F491;
+
+    void dispatch();
+};
+
+extern DaliSimClass DaliSim;
@@ -0,0 +1,45 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file TimerInterrupt_Generic.h
+ * @brief Simulated hardware timer for host builds
+ *
+ * Provides the subset of the TimerInterrupt_Generic API used by DaliBus.cpp. Ticks are
+ * driven by the simulated clock of DaliSim.h.
+ */
+
+#include <stdint.h>
+
+class HostTimer {
+  public:
+    HostTimer(uint8_t timer = 0) : id(timer) {}
+
+    bool attachInterrupt(float frequency, void (*callback)());
+    void detachInterrupt();
+    void restartTimer();
+    void stopTimer();
+
+    uint8_t id;
+    uint32_t period = 0;      // tick period in µs
+    uint64_t next = 0;        // simulated time of next tick
+    bool running = false;
+    uint32_t ticks = 0;       // number of interrupts
+    void (*isr)() = nullptr;
+};
@@ -0,0 +1,983 @@
+/** @file dali_sim_bench.cpp
+ *  measure frame throughput and commissioning time on the simulated bus
+ *
+ *  usage: dali_sim_bench [max devices]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Arduino.h"
+#include "DaliSim.h"
+#include "Dali.h"
+#include "DaliShadow.h"
+#include "DaliInventory.h"
+#include "DaliPlanner.h"
+#include "DaliColour.h"
+#include "DaliMemory.h"
+#include "DaliEvents.h"
+#include "DaliRamp.h"
+#include "DaliPoller.h"
+#include "DaliFaultSearch.h"
+#include "DaliCommissioner.h"
+
+DaliSimBus bus;
+DaliSimGear gear[64];
+
+// additional buses for parallel operation
+DaliSimBus simBus[3];
+DaliSimGear simBusGear[3];
+DaliBusClass daliBus[3];
+DaliClass dali[3] = { DaliClass(daliBus[0]), DaliClass(daliBus[1]), DaliClass(daliBus[2]) };
+
+extern HostTimer timer2; // bus timer of DaliBus.cpp
+
+DaliShadow shadow;
+DaliInventory inventory;
+DaliPlanner planner;
+DaliColour colour;
+DaliMemory memory;
+DaliEvents events;
+DaliRamp ramp;
+DaliPoller poller;
+DaliFaultSearch faultSearch;
+DaliCommissioner commissioner;
+
+static double seconds(uint64_t us) {
+  return us / 1000000.0;
+}
+
+// upper bound in ms of the latency bin holding the median of @p stage
+static unsigned medianLatency(const daliBusStats & stats, daliLatencyStage stage) {
+  uint32_t total = 0, count = 0;
+  for (uint8_t bin = 0; bin < DALI_LATENCY_BINS; bin++)
+    total += stats.latency[stage][bin];
+  for (uint8_t bin = 0; bin < DALI_LATENCY_BINS; bin++)
+    if ((count += stats.latency[stage][bin]) * 2 >= total)
+      return 1u << bin;
+  return 0;
+}
+
+// keep the transmit queue filled for @p duration and return forward frames per second
+static double throughput(bool query, uint64_t duration) {
+  Dali.coalesceArc = false; // every frame should go out
+  uint32_t frames = bus.forwardFrames;
+  uint64_t start = DaliSim.now;
+
+  while (DaliSim.now - start < duration) {
+    while (DaliBus.txQueueFree() > 0)
+      if (query)
+        Dali.sendCmd(0, DaliCmd::QUERY_ACTUAL_LEVEL);
+      else
+        Dali.sendArc(0, 254);
+    DaliSim.run(1000);
+  }
+  while (!DaliBus.busIsIdle())
+    DaliSim.run(1000);
+  Dali.coalesceArc = true;
+
+  return (bus.forwardFrames - frames) / seconds(DaliSim.now - start);
+}
+
+// keep the transmit queues of all four buses filled, returns aggregate forward frames per second
+static double throughputParallel(uint64_t duration) {
+  uint32_t frames = bus.forwardFrames;
+  for (uint8_t i = 0; i < 3; i++)
+    frames += simBus[i].forwardFrames;
+  Dali.coalesceArc = dali[0].coalesceArc = dali[1].coalesceArc = dali[2].coalesceArc = false;
+  uint64_t start = DaliSim.now;
+
+  while (DaliSim.now - start < duration) {
+    while (DaliBus.txQueueFree() > 0)
+      Dali.sendArc(0, 254);
+    for (uint8_t i = 0; i < 3; i++)
+      while (daliBus[i].txQueueFree() > 0)
+        dali[i].sendArc(0, 254);
+    DaliSim.run(1000);
+  }
+  while (!DaliBus.busIsIdle() || !daliBus[0].busIsIdle() || !daliBus[1].busIsIdle() || !daliBus[2].busIsIdle())
+    DaliSim.run(1000);
+  Dali.coalesceArc = dali[0].coalesceArc = dali[1].coalesceArc = dali[2].coalesceArc = true;
+
+  frames = bus.forwardFrames - frames;
+  for (uint8_t i = 0; i < 3; i++)
+    frames += simBus[i].forwardFrames;
+  return frames / seconds(DaliSim.now - start);
+}
+
+// timer interrupts per second on an idle bus
+static double idleTimerRate(uint64_t duration) {
+  uint32_t ticks = timer2.ticks;
+  DaliSim.run(duration);
+  return (timer2.ticks - ticks) / seconds(duration);
+}
+
+// average ms from starting a blocking transaction with device 0 until it returns, @p kind 0: arc power, 1: configuration
+// command (sent twice), 2: query
+static double completion(uint8_t kind, uint8_t count) {
+  uint64_t total = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    DaliSim.run(100000);
+    uint64_t start = DaliSim.now;
+    if (kind == 0)
+      Dali.sendArcWait(0, (i & 1) ? 100 : 200);
+    else
+      Dali.sendCmdWait(0, kind == 1 ? DaliCmd::DTR_AS_FAIL : DaliCmd::QUERY_ACTUAL_LEVEL);
+    total += DaliSim.now - start;
+  }
+  return total / 1000.0 / count;
+}
+
+// poll level and status of device 0 every 100 ms through the shadow, returns the share answered without the bus
+static double shadowPolling(uint64_t duration) {
+  uint32_t frames = bus.forwardFrames;
+  uint32_t polls = 0;
+  uint64_t start = DaliSim.now;
+
+  shadow.begin();
+  while (DaliSim.now - start < duration) {
+    shadow.query(0, DaliCmd::QUERY_ACTUAL_LEVEL);
+    shadow.query(0, DaliCmd::QUERY_STATUS);
+    polls += 2;
+    if (polls % 100 == 0)
+      Dali.sendArc(0, polls % 200 ? 100 : 200);
+    DaliSim.runUntil(start + (uint64_t)polls * 50000);
+    Dali.loop();
+  }
+  Dali.setMonitor(nullptr);
+
+  frames = bus.forwardFrames - frames;
+  return 100.0 * (polls - frames) / polls;
+}
+
+// move a slider for each of 4 devices at 50 Hz for @p duration, returns ms until all levels have settled after
+// the last move, @p lag receives the average age in ms of the level shown by a device while moving
+static double sliders(bool coalesce, uint64_t duration, double & lag, uint32_t & dropped) {
+  static uint64_t moved[256]; // time of each move, levels repeat after 254 moves
+  Dali.coalesceArc = coalesce;
+  uint8_t target[4] = { 0, 0, 0, 0 };
+  uint64_t age = 0;
+  uint32_t samples = 0;
+  dropped = 0;
+  uint64_t start = DaliSim.now;
+  for (uint32_t step = 0; ; step++) {
+    uint64_t now = start + step * 1000ull;
+    bool moving = now - start < duration;
+    if (moving && step % 20 == 0) {
+      moved[step / 20 % 254] = now;
+      for (uint8_t i = 0; i < 4; i++) {
+        target[i] = 1 + (step / 20 * 7 + i * 50) % 254;
+        if (Dali.sendArc(i * 16, target[i]) != DALI_SENT)
+          dropped++;
+      }
+    }
+    DaliSim.runUntil(now + 1000);
+    bool settled = true;
+    for (uint8_t i = 0; i < 4; i++) {
+      settled = settled && gear[i].actualLevel == target[i];
+      if (moving && gear[i].actualLevel != 0) {
+        // find the move that set the level shown, level = 1 + (move * 7 + i * 50) % 254
+        uint8_t move = (gear[i].actualLevel - 1 + 254 * 7 - i * 50) * 109 % 254; // 109 * 7 = 1 mod 254
+        age += now + 1000 - moved[move];
+        samples++;
+      }
+    }
+    if (!moving && (settled || now - start > duration + 10000000))
+      break;
+  }
+  Dali.coalesceArc = true;
+  lag = samples ? age / 1000.0 / samples : 0;
+  return (DaliSim.now - start - duration) / 1000.0;
+}
+
+// put @p count devices with short addresses spread over the address range on the bus
+static void populate(uint8_t count) {
+  bus.clear();
+  for (uint8_t i = 0; i < count; i++) {
+    gear[i].factoryReset(i * (64 / count));
+    bus.add(gear[i]);
+  }
+}
+
+// query all values of all short addresses one after the other, returns duration
+static uint64_t inventorySequential() {
+  static const DaliCmd queries[] = {
+    DaliCmd::QUERY_DEVICE_TYPE, DaliCmd::QUERY_VERSION, DaliCmd::QUERY_PHYS_MIN, DaliCmd::QUERY_MIN_LEVEL,
+    DaliCmd::QUERY_MAX_LEVEL, DaliCmd::QUERY_GROUPS_0_7, DaliCmd::QUERY_GROUPS_8_15, DaliCmd::QUERY_ADDRH,
+    DaliCmd::QUERY_ADDRM, DaliCmd::QUERY_ADDRL, DaliCmd::QUERY_STATUS
+  };
+  uint64_t start = DaliSim.now;
+  for (uint8_t address = 0; address < 64; address++)
+    for (uint8_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+      Dali.sendCmdAsync(address, queries[i]).wait(100);
+  return DaliSim.now - start;
+}
+
+// pipelined inventory scan, returns false if not all devices have been found completely
+static bool inventoryPipelined(uint8_t count, uint64_t & duration) {
+  duration = DaliSim.now;
+  inventory.start();
+  while (inventory.tick())
+    DaliSim.run(100);
+  duration = DaliSim.now - duration;
+
+  if (inventory.count() != count || inventory.incomplete) return false;
+  for (uint8_t i = 0; i < count; i++) {
+    const daliInventoryEntry &entry = inventory.devices[gear[i].shortAddress];
+    if (entry.randomAddress != gear[i].randomAddress || entry.deviceType != gear[i].deviceType) return false;
+  }
+  return true;
+}
+
+// set the 64 devices of populate(64) to @p levels one by one or through the planner, returns the time until all of
+// them are at their level, @p frames receives the number of frames sent
+static uint64_t scene(const uint8_t * levels, bool planned, uint32_t & frames) {
+  frames = bus.forwardFrames;
+  uint64_t start = DaliSim.now;
+  if (planned) {
+    planner.start(levels);
+    while (planner.tick())
+      DaliSim.run(100);
+  } else {
+    for (uint8_t i = 0; i < 64; i++)
+      while (levels[i] != 0xFF && Dali.sendArc(i, levels[i]) != DALI_SENT)
+        DaliSim.run(100);
+  }
+  while (!DaliBus.busIsIdle())
+    DaliSim.run(100);
+  frames = bus.forwardFrames - frames;
+  for (uint8_t i = 0; i < 64; i++)
+    if (levels[i] != 0xFF && gear[i].actualLevel != levels[i])
+      return 0;
+  return DaliSim.now - start;
+}
+
+// set max and min level of the 16 devices of populate(16) with DTR writes while another master on the bus writes
+// the fade time of an absent address every 250 ms, returns the number of devices configured correctly
+static uint8_t configPush(bool sequences, uint64_t & duration, uint32_t & retries) {
+  DaliSequence other(dali[2]);
+  other.special(DaliSpecialCmd::SET_DTR, 7).cmd(63, DaliCmd::DTR_AS_FADE_TIME);
+  uint64_t nextOther = DaliSim.now;
+  DaliSequence push(Dali);
+  DaliTransaction pending(DALI_NO_ERROR);
+  uint8_t device = 0;
+  uint8_t frame = 0; // next frame of push to queue one by one
+  retries = 0;
+  duration = DaliSim.now;
+
+  while (device < 16) {
+    if (DaliSim.now >= nextOther) {
+      other.send();
+      nextOther += 250000;
+    }
+    if (pending.ready()) {
+      if (pending.result() == DALI_COLLISION) {
+        retries++;
+        pending = push.send();
+      } else if (frame == 0) {
+        uint8_t address = gear[device].shortAddress;
+        push.clear().special(DaliSpecialCmd::SET_DTR, 200).cmd(address, DaliCmd::DTR_AS_MAX)
+            .special(DaliSpecialCmd::SET_DTR, 20).cmd(address, DaliCmd::DTR_AS_MIN);
+        if (sequences) {
+          pending = push.send();
+          device++;
+        } else {
+          frame = 1;
+        }
+      }
+    }
+    if (frame) { // same frames, each queued on its own
+      static const byte frames[6][2] = { { 0xA3, 200 }, { 1, 42 }, { 1, 42 }, { 0xA3, 20 }, { 1, 43 }, { 1, 43 } };
+      byte message[2] = { frames[frame - 1][0], frames[frame - 1][1] };
+      if (message[0] == 1)
+        message[0] |= gear[device].shortAddress << 1;
+      if (DaliBus.sendRaw(message, 16) == DALI_SENT && ++frame > 6) {
+        frame = 0;
+        device++;
+      }
+    }
+    DaliSim.run(100);
+  }
+  while (!pending.ready() || !DaliBus.busIsIdle() || !daliBus[2].busIsIdle())
+    DaliSim.run(100);
+  duration = DaliSim.now - duration;
+
+  uint8_t configured = 0;
+  for (uint8_t i = 0; i < 16; i++)
+    configured += gear[i].maxLevel == 200 && gear[i].minLevel == 20;
+  return configured;
+}
+
+// step the colour temperature of the 4 groups of 16 DT8 devices from 250 to 250 + @p steps mirek, one group after
+// the other, returns the number of devices ending up with the last value
+static uint8_t colourSweep(bool reuse, uint16_t steps, uint32_t & frames, uint64_t & duration) {
+  colour.reuseDtr = reuse;
+  frames = bus.forwardFrames;
+  duration = DaliSim.now;
+  for (uint16_t mirek = 250; mirek <= 250 + steps; mirek++)
+    for (uint8_t group = 0; group < 4; group++)
+      if (colour.setColourTemperature(group, mirek, DaliAddressTypes::GROUP) != DALI_RX_EMPTY)
+        return 0;
+  while (!DaliBus.busIsIdle())
+    DaliSim.run(100);
+  frames = bus.forwardFrames - frames;
+  duration = DaliSim.now - duration;
+
+  uint8_t updated = 0;
+  for (uint8_t i = 0; i < 16; i++)
+    updated += gear[i].colourTemperature == 250 + steps;
+  return updated;
+}
+
+// ramp groups 0-3 and short addresses 60-63 of populate(64) from 0 to 254 within 10 s, with DaliRamp or by sending each
+// changed level at once, while querying device 0 every 250 ms. Returns the number of devices at 254 afterwards,
+// @p frames receives the frames sent, @p latency the average time in ms until a query was answered, @p failed the
+// queries that couldn't be queued or weren't answered
+static uint8_t ramps(bool engine, uint32_t & frames, double & latency, uint32_t & failed) {
+  static const byte addresses[8] = { 0, 1, 2, 3, 60, 61, 62, 63 };
+  uint8_t sent[8];
+  for (uint8_t i = 0; i < 64; i++)
+    gear[i].groups = i < 60 ? 1 << (i / 15) : 0;
+  memset(sent, 0xFF, sizeof(sent));
+  if (engine)
+    for (uint8_t i = 0; i < 8; i++)
+      ramp.start(addresses[i], 0, 254, 10000, i < 4 ? DaliAddressTypes::GROUP : DaliAddressTypes::SHORT);
+  frames = bus.forwardFrames;
+  DaliTransaction query(DALI_NO_ERROR);
+  uint64_t queried = 0, latencySum = 0;
+  uint32_t queries = 0, answered = 0;
+  failed = 0;
+  uint64_t start = DaliSim.now;
+  while (DaliSim.now - start < 12000000) {
+    uint64_t time = DaliSim.now - start;
+    if (engine) {
+      ramp.tick();
+    } else {
+      for (uint8_t i = 0; i < 8; i++) {
+        uint8_t level = DaliRamp::level(0, 254, time >= 10000000 ? 0xFFFF : time * 0xFFFF / 10000000, DALI_RAMP_LIGHT);
+        if (level != sent[i] &&
+            Dali.sendArc(addresses[i], level, i < 4 ? DaliAddressTypes::GROUP : DaliAddressTypes::SHORT) == DALI_SENT)
+          sent[i] = level;
+      }
+    }
+    if (queried && query.ready()) {
+      if (query.result() >= 0) {
+        latencySum += DaliSim.now - queried;
+        answered++;
+      } else {
+        failed++;
+      }
+      queries++;
+      queried = 0;
+    }
+    if (!queried && time / 250000 >= queries) {
+      query = Dali.sendCmdAsync(0, DaliCmd::QUERY_ACTUAL_LEVEL);
+      queried = DaliSim.now;
+    }
+    DaliSim.run(1000);
+  }
+  while (!DaliBus.busIsIdle())
+    DaliSim.run(1000);
+  frames = bus.forwardFrames - frames - answered;
+  latency = answered ? latencySum / 1000.0 / answered : 0;
+  uint8_t reached = 0;
+  for (uint8_t i = 0; i < 64; i++)
+    reached += gear[i].actualLevel == 254;
+  return reached;
+}
+
+static uint64_t lampFailureSeen = 0;
+
+static void pollChanged(byte address, DaliCmd query, int value, int previous, void * context) {
+  if (address == gear[5].shortAddress && query == DaliCmd::QUERY_LAMP_FAILURE && value == 0xFF && !lampFailureSeen)
+    lampFailureSeen = DaliSim.now;
+}
+
+// poll the 16 devices of populate(16) in the background (if @p poll) for 30 s while sending a level to device 0 every
+// @p user_interval ms on average (0 for none), the lamp of device 5 fails after 10 s. The poller has queried all
+// devices once before. Returns the average latency of the levels in ms, @p detected receives the ms until the failure
+// was reported, @p polls the polls per second
+static double polling(bool poll, uint32_t user_interval, double & detected, double & polls) {
+  poller.addresses = 0;
+  for (uint8_t i = 0; i < 16; i++)
+    poller.addresses |= (uint64_t)1 << gear[i].shortAddress;
+  poller.clear();
+  poller.changedCallback = pollChanged;
+  poller.polls = 0;
+  while (poll && poller.polls < 16 * 3 + 1) {
+    poller.tick();
+    DaliSim.run(1000);
+  }
+  poller.polls = 0;
+  lampFailureSeen = 0;
+  DaliTransaction level(DALI_NO_ERROR);
+  uint64_t sent = 0, latency = 0, next = 0;
+  uint32_t levels = 0;
+  uint64_t start = DaliSim.now;
+  while (DaliSim.now - start < 30000000) {
+    uint64_t time = DaliSim.now - start;
+    gear[5].lampFailure = time >= 10000000;
+    if (poll)
+      poller.tick();
+    if (sent && level.ready()) {
+      latency += DaliSim.now - sent;
+      sent = 0;
+    }
+    if (user_interval && !sent && time >= next) {
+      level = Dali.sendArcAsync(0, levels % 2 ? 100 : 200);
+      sent = DaliSim.now;
+      levels++;
+      next = time + (user_interval / 2 + DaliSim.random() % user_interval) * 1000;
+    }
+    DaliSim.run(1000);
+  }
+  while (!DaliBus.busIsIdle())
+    DaliSim.run(1000);
+  gear[5].lampFailure = false;
+  poller.addresses = 0;
+  detected = lampFailureSeen ? (lampFailureSeen - start - 10000000) / 1000.0 : -1;
+  polls = poller.polls / 30.0;
+  return levels ? latency / 1000.0 / levels : 0;
+}
+
+// find the devices of populate(64) with a lamp failure by asking each address or with DaliFaultSearch, splitting by the
+// groups of the last inventory scan, @p groups 0: none known, 1: all known, 2: those of every 8th device unknown.
+// Returns the devices found, @p frames receives the number of queries
+static uint64_t lampFailures(bool search, uint8_t groups, uint32_t & frames, uint64_t & duration) {
+  frames = bus.forwardFrames;
+  duration = DaliSim.now;
+  uint64_t found = 0;
+  if (search) {
+    faultSearch.load(inventory);
+    for (uint8_t i = 0; i < 64; i++)
+      if (groups == 0 || (groups == 2 && i % 8 == 3))
+        faultSearch.setGroupsUnknown(i);
+    faultSearch.start(DaliCmd::QUERY_LAMP_FAILURE, inventory.present);
+    while (faultSearch.tick())
+      DaliSim.run(100);
+    found = faultSearch.found;
+  } else {
+    for (uint8_t i = 0; i < 64; i++) {
+      int result = Dali.sendCmdAsync(i, DaliCmd::QUERY_LAMP_FAILURE).wait(100);
+      if (result >= 0 || result == DALI_RX_ERROR)
+        found |= 1ULL << i;
+    }
+  }
+  frames = bus.forwardFrames - frames;
+  duration = DaliSim.now - duration;
+  return found;
+}
+
+// send a level to device 0 every 100 ms while another master keeps polling it with @p poll_priority, returns the
+// average latency of the levels in ms, @p lost receives the levels that failed, @p polls the polls per second
+static double arbitration(daliPriority poll_priority, uint64_t duration, uint32_t & lost, double & polls,
+                          uint32_t & retries) {
+  daliBus[2].priority = poll_priority;
+  DaliBus.resetStats();
+  daliBus[2].resetStats();
+  DaliTransaction pending(DALI_NO_ERROR);
+  uint64_t sent = 0, latency = 0;
+  uint32_t levels = 0;
+  lost = 0;
+  uint64_t start = DaliSim.now;
+  while (DaliSim.now - start < duration) {
+    while (dali[2].sendCmdAsync(0, DaliCmd::QUERY_ACTUAL_LEVEL).result() != DALI_BUSY);
+    if (pending.ready()) {
+      if (sent) {
+        latency += DaliSim.now - sent;
+        lost += pending.result() == DALI_COLLISION;
+        sent = 0;
+      }
+      if (DaliSim.now - start >= levels * 100000ull) {
+        pending = Dali.sendArcAsync(0, 100 + levels % 2 * 100);
+        sent = DaliSim.now;
+        levels++;
+      }
+    }
+    DaliSim.run(100);
+  }
+  while (!DaliBus.busIsIdle() || !daliBus[2].busIsIdle())
+    DaliSim.run(100);
+  daliBus[2].priority = DALI_PRIORITY_USER;
+
+  daliBusStats stats, otherStats;
+  DaliBus.getStats(stats);
+  daliBus[2].getStats(otherStats);
+  polls = otherStats.framesSent / seconds(duration);
+  retries = stats.collisionRetries + otherStats.collisionRetries;
+  return latency / 1000.0 / levels;
+}
+
+// occupancy sensor at short address 5 switching device 0, see occupancy()
+static uint64_t occupancyEvent = 0, occupancyHandled = 0;
+
+static void occupancyChanged(const daliEvent & event, void * context) {
+  occupancyEvent = event.timestamp;
+  occupancyHandled = DaliSim.now;
+  Dali.sendArcAsync(0, event.info ? 254 : 0);
+}
+
+// send @p count occupancy events (instance type 3) from another bus interface, each switching device 0 on or off,
+// returns the number of events the lamp followed, @p decoded receives the average time from the start bit of the event
+// to its handler, @p reacted the average time from the handler to the new level in ms
+static uint8_t occupancy(uint8_t count, double & decoded, double & reacted) {
+  events.on(DaliEvents::device(5, DALI_INSTANCE_OCCUPANCY), DaliEvents::ANY, occupancyChanged);
+  events.begin();
+  uint64_t decodedSum = 0, reactedSum = 0;
+  uint8_t followed = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t level = i % 2 ? 254 : 0;
+    uint16_t source = DaliEvents::device(5, DALI_INSTANCE_OCCUPANCY);
+    uint8_t frame[3] = { (uint8_t)(source >> 6), (uint8_t)(source << 2), (uint8_t)(level != 0) };
+    occupancyHandled = 0;
+    dali[2].sendRawAsync(frame, 24);
+    uint64_t start = DaliSim.now;
+    while ((!occupancyHandled || gear[0].actualLevel != level) && DaliSim.now - start < 200000) {
+      DaliSim.run(100);
+      Dali.loop();
+    }
+    if (gear[0].actualLevel == level && occupancyHandled) {
+      followed++;
+      decodedSum += occupancyHandled - occupancyEvent;
+      reactedSum += DaliSim.now - occupancyHandled;
+    }
+    DaliSim.run(250000);
+  }
+  events.end();
+  events.clear();
+  decoded = followed ? decodedSum / 1000.0 / followed : 0;
+  reacted = followed ? reactedSum / 1000.0 / followed : 0;
+  return followed;
+}
+
+// read memory bank 0 (27 locations) of the 16 devices of populate(16) location by location or streamed, with another
+// master writing DTR0 every 250 ms if @p other, returns the number of devices read correctly
+static uint8_t memoryRead(bool streamed, bool other, uint32_t & frames, uint64_t & duration) {
+  DaliSequence write(dali[2]);
+  write.special(DaliSpecialCmd::SET_DTR, 7).cmd(63, DaliCmd::DTR_AS_FADE_TIME);
+  uint64_t nextOther = DaliSim.now;
+  uint8_t content[16][27];
+  memset(content, 0, sizeof(content));
+  frames = bus.forwardFrames;
+  duration = DaliSim.now;
+
+  for (uint8_t i = 0; i < 16; i++) {
+    uint8_t address = gear[i].shortAddress;
+    if (streamed)
+      memory.startRead(address, 0, 0, content[i], 27);
+    else
+      Dali.sendSpecialCmdWait(DaliSpecialCmd::SET_DTR1, 0);
+    for (uint8_t location = 0; streamed ? memory.tick() : location < 27; location++) {
+      if (other && DaliSim.now >= nextOther) {
+        write.send();
+        nextOther += 250000;
+      }
+      if (streamed) {
+        DaliSim.run(100);
+      } else {
+        Dali.sendSpecialCmdWait(DaliSpecialCmd::SET_DTR, location);
+        int result = Dali.sendCmdWait(address, DaliCmd::READ_MEM_LOC);
+        if (result >= 0) content[i][location] = result;
+      }
+    }
+  }
+  while (!DaliBus.busIsIdle() || !daliBus[2].busIsIdle())
+    DaliSim.run(100);
+  frames = bus.forwardFrames - frames;
+  duration = DaliSim.now - duration;
+
+  uint8_t correct = 0;
+  for (uint8_t i = 0; i < 16; i++)
+    correct += memcmp(content[i], gear[i].memory[0], 27) == 0;
+  return correct;
+}
+
+// unlock memory bank 1 of the 16 devices of populate(16) and write 16 locations, verified, with another master writing
+// DTR0 every 250 ms if @p other, returns the number of devices written successfully
+static uint8_t memoryWrite(bool other, uint32_t & frames, uint64_t & duration) {
+  DaliSequence write(dali[2]);
+  write.special(DaliSpecialCmd::SET_DTR, 7).cmd(63, DaliCmd::DTR_AS_FADE_TIME);
+  uint64_t nextOther = DaliSim.now;
+  uint8_t data[17] = { 0x55 }; // lock byte, then the content
+  frames = bus.forwardFrames;
+  duration = DaliSim.now;
+
+  uint8_t written = 0;
+  for (uint8_t i = 0; i < 16; i++) {
+    for (uint8_t n = 1; n < 17; n++)
+      data[n] = i * 16 + n;
+    memory.startWrite(gear[i].shortAddress, 1, 2, data, 17);
+    while (memory.tick()) {
+      if (other && DaliSim.now >= nextOther) {
+        write.send();
+        nextOther += 250000;
+      }
+      DaliSim.run(100);
+    }
+    written += memory.result() == 17 && memcmp(&gear[i].memory[1][2], data, 17) == 0;
+  }
+  while (!DaliBus.busIsIdle() || !daliBus[2].busIsIdle())
+    DaliSim.run(100);
+  frames = bus.forwardFrames - frames;
+  duration = DaliSim.now - duration;
+  return written;
+}
+
+// commission @p count fresh devices, returns false if not all of them got a unique short address
+static bool commission(uint8_t count, uint32_t & frames, uint64_t & duration) {
+  bus.clear();
+  for (uint8_t i = 0; i < count; i++) {
+    gear[i].factoryReset();
+    bus.add(gear[i]);
+  }
+
+  frames = bus.forwardFrames;
+  duration = DaliSim.now;
+
+  Dali.commission();
+  while (Dali.commissionState != DaliClass::COMMISSION_OFF) {
+    Dali.commission_tick();
+    DaliSim.run(100);
+  }
+  while (!DaliBus.busIsIdle())
+    DaliSim.run(100);
+
+  frames = bus.forwardFrames - frames;
+  duration = DaliSim.now - duration;
+
+  uint64_t used = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t address = gear[i].shortAddress;
+    if (address > 63 || (used & (1ULL << address)))
+      return false;
+    used |= 1ULL << address;
+  }
+  return Dali.nextShortAddress == count;
+}
+
+// commission the 32 devices of populate(32), known from an inventory scan, after @p change: 1 a device replaced by a
+// new one, 2 a spare with the short address of another device added, 3 a new device added. With DaliCommissioner, or
+// all anew with DaliClass::commission() if @p full. Returns false if the short addresses aren't unique afterwards or
+// DaliCommissioner has changed the one of a device other than the changed one, @p moved receives the number of devices
+// with another short address than before
+static bool recommission(uint8_t change, bool full, uint32_t & frames, uint64_t & duration, uint8_t & moved) {
+  populate(32);
+  for (uint8_t i = 0; i < 32; i++)
+    gear[i].randomAddress = DaliSim.random() & 0xFFFFFF;
+  inventory.start(INVENTORY_RANDOM_ADDRESS);
+  while (inventory.tick())
+    DaliSim.run(100);
+  commissioner.load(inventory);
+
+  uint8_t count = 32, changed = 0xFF, replaced = gear[7].shortAddress;
+  if (change == 1) {
+    changed = 7;
+    gear[changed].factoryReset();
+  } else if (change >= 2) {
+    changed = count++;
+    gear[changed].factoryReset(change == 2 ? gear[3].shortAddress : 0xFF);
+    gear[changed].randomAddress = DaliSim.random() & 0xFFFFFF;
+    bus.add(gear[changed]);
+  }
+  uint8_t before[33];
+  for (uint8_t i = 0; i < count; i++)
+    before[i] = gear[i].shortAddress;
+
+  frames = bus.forwardFrames;
+  duration = DaliSim.now;
+  if (full) {
+    Dali.commission();
+    while (Dali.commissionState != DaliClass::COMMISSION_OFF) {
+      Dali.commission_tick();
+      DaliSim.run(100);
+    }
+  } else {
+    commissioner.start();
+    while (commissioner.tick())
+      DaliSim.run(100);
+  }
+  while (!DaliBus.busIsIdle())
+    DaliSim.run(100);
+  frames = bus.forwardFrames - frames;
+  duration = DaliSim.now - duration;
+
+  uint64_t used = 0;
+  moved = 0;
+  bool ok = full || commissioner.result() == DALI_NO_ERROR;
+  if (!full && change == 1) // the replacement takes over the short address
+    ok = ok && gear[changed].shortAddress == replaced;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t address = gear[i].shortAddress;
+    if (address > 63 || (used & (1ULL << address)))
+      ok = false;
+    used |= 1ULL << address;
+    if (address != before[i]) {
+      moved++;
+      ok = ok && (full || i == changed);
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char ** argv) {
+  int maxDevices = (argc > 1) ? atoi(argv[1]) : 64;
+  if (maxDevices < 1 || maxDevices > 64) {
+    fprintf(stderr, "usage: %s [max devices (1-64)]\n", argv[0]);
+    return 2;
+  }
+
+  clock_t wall = clock();
+  DaliSim.connect(bus, 2, 3);
+  Dali.begin(2, 3);
+  DaliSim.run(100000);
+
+  printf("frame throughput (10 s simulated)\n");
+  gear[0].factoryReset(0);
+  bus.add(gear[0]);
+  printf("  arc frames, no response   %6.1f frames/s\n", throughput(false, 10000000));
+  DaliBus.resetStats();
+  printf("  queries, with response    %6.1f frames/s\n", throughput(true, 10000000));
+  daliBusStats stats;
+  DaliBus.getStats(stats);
+  printf("  bus utilization           %6u %%\n", stats.utilization);
+  printf("  median latency            queued <%u ms, transmit <%u ms, response <%u ms\n",
+         medianLatency(stats, DALI_LATENCY_QUEUED), medianLatency(stats, DALI_LATENCY_TRANSMIT),
+         medianLatency(stats, DALI_LATENCY_RESPONSE));
+
+  for (uint8_t i = 0; i < 3; i++) {
+    DaliSim.connect(simBus[i], 4 + 2 * i, 5 + 2 * i);
+    simBusGear[i].factoryReset(0);
+    simBus[i].add(simBusGear[i]);
+    dali[i].begin(4 + 2 * i, 5 + 2 * i);
+  }
+  printf("  arc frames on 4 buses     %6.1f frames/s\n", throughputParallel(10000000));
+
+  printf("  timer interrupts when idle %6.1f /s\n", idleTimerRate(10000000));
+
+  printf("\ntransaction completion, sent on an idle bus\n");
+  printf("  arc power                 %6.1f ms\n", completion(0, 20));
+  printf("  configuration command     %6.1f ms\n", completion(1, 20));
+  printf("  query                     %6.1f ms\n", completion(2, 20));
+
+  printf("\nshadowed polling (60 s simulated)\n");
+  printf("  polls answered locally    %6.1f %%\n", shadowPolling(60000000));
+
+  printf("\nslider at 50 Hz on 4 devices (5 s simulated)\n");
+  printf("  coalescing  updates dropped  average lag  settled after\n");
+  populate(4);
+  for (int coalesce = 0; coalesce <= 1; coalesce++) {
+    double lag;
+    uint32_t dropped;
+    double settle = sliders(coalesce, 5000000, lag, dropped);
+    printf("  %10s  %15u  %8.0f ms  %10.0f ms\n", coalesce ? "on" : "off", dropped, lag, settle);
+  }
+
+  printf("\ninventory scan\n");
+  printf("  devices  sequential [s]  pipelined [s]\n");
+  bool ok = true;
+  for (int count = 0; count <= 64; count = count ? count * 4 : 1) {
+    populate(count);
+    uint64_t sequential = inventorySequential();
+    uint64_t pipelined;
+    bool found = inventoryPipelined(count, pipelined);
+    printf("  %7d  %14.2f  %13.2f%s\n", count, seconds(sequential), seconds(pipelined), found ? "" : "  FAILED");
+    ok = ok && found;
+  }
+
+  // office floor: 4 zones of 16 devices in groups 0-3, the devices next to the windows also in group 4
+  printf("\nscene change on 64 devices\n");
+  printf("  scene                   frames one by one  frames planned  time one by one [s]  time planned [s]\n");
+  populate(64);
+  for (uint8_t i = 0; i < 64; i++)
+    gear[i].groups = (1 << (i / 16)) | (i % 8 == 0 ? 1 << 4 : 0);
+  inventory.start(INVENTORY_GROUPS);
+  while (inventory.tick())
+    DaliSim.run(100);
+  planner.load(inventory);
+  static const char * sceneNames[] = { "all equal", "zones", "zones and windows", "zones and 3 desks" };
+  for (uint8_t n = 0; n < 4; n++) {
+    uint8_t levels[64];
+    for (uint8_t i = 0; i < 64; i++) {
+      levels[i] = n == 0 ? 200 : 100 + 40 * (i / 16);
+      if (n == 2 && i % 8 == 0) levels[i] = 60;
+      if (n == 3 && i % 21 == 5) levels[i] = 254;
+    }
+    uint32_t single, planned;
+    uint64_t singleTime = scene(levels, false, single);
+    uint64_t plannedTime = scene(levels, true, planned);
+    printf("  %-22s  %17u  %14u  %19.2f  %16.2f%s\n", sceneNames[n], single, planned, seconds(singleTime),
+           seconds(plannedTime), singleTime && plannedTime ? "" : "  FAILED");
+    ok = ok && singleTime && plannedTime;
+  }
+
+  printf("\nlevel every 100 ms while another master polls continuously (10 s simulated)\n");
+  printf("  poll priority  levels lost  average latency  polls/s  collision retries\n");
+  DaliSim.connect(bus, 10, 11);
+  dali[2].begin(10, 11);
+  populate(1);
+  for (int priority = DALI_PRIORITY_USER; priority <= DALI_PRIORITY_POLL; priority += 3) {
+    uint32_t lost, retries;
+    double polls;
+    double latency = arbitration((daliPriority)priority, 10000000, lost, polls, retries);
+    printf("  %13d  %11u  %12.1f ms  %7.1f  %17u\n", priority, lost, latency, polls, retries);
+    ok = ok && lost == 0;
+  }
+
+  printf("\nbackground polling of 16 devices, lamp failure after 10 s (30 s simulated)\n");
+  printf("  poller  level every  level latency  polls/s  failure reported after\n");
+  populate(16);
+  static const uint32_t userIntervals[5] = { 500, 100, 0, 500, 100 };
+  for (int row = 0; row < 5; row++) {
+    bool poll = row >= 2;
+    uint32_t userInterval = userIntervals[row];
+    double detected, polls;
+    double latency = polling(poll, userInterval, detected, polls);
+    char interval[16] = "-", levelLatency[16] = "-", reported[16] = "-";
+    if (userInterval) {
+      snprintf(interval, sizeof(interval), "%u ms", userInterval);
+      snprintf(levelLatency, sizeof(levelLatency), "%.1f ms", latency);
+    }
+    if (poll)
+      snprintf(reported, sizeof(reported), "%.0f ms", detected);
+    printf("  %6s  %11s  %13s  %7.1f  %22s\n", poll ? "on" : "off", interval, levelLatency, polls, reported);
+    ok = ok && (!poll || detected >= 0);
+  }
+
+  // 4 zones of 16 devices in groups 0-3, 8 rows of 8 in groups 4-11, answers with jitter to garble simultaneous ones
+  printf("\nlamp failure search on 64 devices in 4 zones and 8 rows\n");
+  printf("  failures  groups known  frames one by one  frames searched  time one by one [s]  time searched [s]\n");
+  populate(64);
+  for (uint8_t i = 0; i < 64; i++) {
+    gear[i].groups = (1 << (i / 16)) | (1 << (4 + i / 8));
+    gear[i].replyJitter = 2;
+  }
+  inventory.start(INVENTORY_GROUPS);
+  while (inventory.tick())
+    DaliSim.run(100);
+  static const uint8_t failed[3] = { 37, 38, 5 };
+  static const uint8_t failures[7] = { 0, 1, 3, 1, 3, 1, 3 };
+  static const char * const known[3] = { "no", "yes", "7 of 8" };
+  for (int row = 0; row < 7; row++) {
+    uint8_t groups = row < 3 ? 1 : row < 5 ? 0 : 2; // 2: groups of every 8th device unknown
+    uint64_t expected = 0;
+    for (uint8_t i = 0; i < 64; i++)
+      gear[i].lampFailure = false;
+    for (uint8_t i = 0; i < failures[row]; i++) {
+      gear[failed[i]].lampFailure = true;
+      expected |= 1ULL << gear[failed[i]].shortAddress;
+    }
+    uint32_t single, searched;
+    uint64_t singleTime, searchedTime;
+    bool correct = lampFailures(false, groups, single, singleTime) == expected;
+    correct = lampFailures(true, groups, searched, searchedTime) == expected && correct;
+    printf("  %8u  %12s  %17u  %15u  %19.2f  %17.2f%s\n", failures[row], known[groups], single, searched,
+           seconds(singleTime), seconds(searchedTime), correct ? "" : "  FAILED");
+    ok = ok && correct;
+  }
+  for (uint8_t i = 0; i < 64; i++) {
+    gear[i].lampFailure = false;
+    gear[i].replyJitter = 0;
+  }
+
+  printf("\nconfiguration push to 16 devices, other master writing DTR every 250 ms\n");
+  printf("  frames               configured  retries  time [s]\n");
+  for (int sequences = 0; sequences <= 1; sequences++) {
+    populate(16);
+    uint64_t duration;
+    uint32_t retries;
+    uint8_t configured = configPush(sequences, duration, retries);
+    printf("  %-19s  %7u/16  %7u  %8.2f\n", sequences ? "sequences" : "one by one", configured, retries,
+           seconds(duration));
+    ok = ok && (!sequences || configured == 16);
+  }
+
+  printf("\nmemory bank access on 16 devices\n");
+  printf("  transfer                             other master  frames  correct  time [s]\n");
+  populate(16);
+  for (int other = 0; other <= 1; other++)
+    for (int streamed = 0; streamed <= 1; streamed++) {
+      uint32_t frames;
+      uint64_t duration;
+      uint8_t correct = memoryRead(streamed, other, frames, duration);
+      printf("  read bank 0, %-22s  %12s  %6u  %4u/16  %8.2f\n", streamed ? "streamed" : "location by location",
+             other ? "yes" : "no", frames, correct, seconds(duration));
+      ok = ok && (!streamed || correct == 16);
+    }
+  for (int other = 0; other <= 1; other++) {
+    uint32_t frames;
+    uint64_t duration;
+    uint8_t written = memoryWrite(other, frames, duration);
+    printf("  write bank 1, 17 locations, verified  %12s  %6u  %4u/16  %8.2f\n", other ? "yes" : "no", frames,
+           written, seconds(duration));
+    ok = ok && (other || written == 16);
+  }
+
+  printf("\noccupancy sensor on another bus interface switching a lamp, 20 events\n");
+  printf("  events followed  event to handler  handler to new level\n");
+  populate(1);
+  double decoded, reacted;
+  uint8_t followed = occupancy(20, decoded, reacted);
+  printf("  %12u/20  %13.1f ms  %17.1f ms\n", followed, decoded, reacted);
+  ok = ok && followed == 20;
+  dali[2].begin(8, 9);
+
+  printf("\nramps of 4 groups and 4 devices, 64 devices in total, from 0 to 254 in 10 s, query every 250 ms\n");
+  printf("  levels sent      frames  query latency  queries failed  at 254\n");
+  for (int engine = 0; engine <= 1; engine++) {
+    populate(64);
+    uint32_t frames, failed;
+    double latency;
+    uint8_t reached = ramps(engine, frames, latency, failed);
+    printf("  %-15s  %6u  %10.1f ms  %14u  %4u/64\n", engine ? "DaliRamp" : "each change", frames, latency, failed,
+           reached);
+    ok = ok && reached == 64 && (!engine || failed == 0);
+  }
+
+  printf("\ncolour temperature sweep on 4 groups of DT8 devices, 250-505 mirek\n");
+  printf("  DTR reuse  frames  frames/step  steps/s  updated\n");
+  populate(16);
+  for (uint8_t i = 0; i < 16; i++) {
+    gear[i].deviceType = 8;
+    gear[i].groups = 1 << (i / 4);
+  }
+  for (int reuse = 0; reuse <= 1; reuse++) {
+    uint32_t frames;
+    uint64_t duration;
+    uint8_t updated = colourSweep(reuse, 255, frames, duration);
+    printf("  %9s  %6u  %11.1f  %7.1f  %4u/16\n", reuse ? "on" : "off", frames, frames / 256.0 / 4,
+           256 * 4 / seconds(duration), updated);
+    ok = ok && updated == 16;
+  }
+  for (uint8_t i = 0; i < 16; i++)
+    gear[i].deviceType = 6;
+
+  printf("\nrecommissioning 32 devices\n");
+  printf("  change                  frames  time [s]  readdressed  full: frames  time [s]  readdressed\n");
+  static const char * changeNames[4] = { "none", "device replaced", "duplicate address", "device added" };
+  for (uint8_t change = 0; change < 4; change++) {
+    uint32_t frames, fullFrames;
+    uint64_t duration, fullDuration;
+    uint8_t moved, fullMoved;
+    bool correct = recommission(change, false, frames, duration, moved);
+    correct = recommission(change, true, fullFrames, fullDuration, fullMoved) && correct;
+    printf("  %-22s  %6u  %8.2f  %11u  %12u  %8.2f  %11u%s\n", changeNames[change], frames, seconds(duration), moved,
+           fullFrames, seconds(fullDuration), fullMoved, correct ? "" : "  FAILED");
+    ok = ok && correct;
+  }
+
+  printf("\ncommissioning\n");
+  printf("  devices  frames  frames/device  time [s]\n");
+  for (int count = 1; count <= maxDevices; count *= 2) {
+    uint32_t frames;
+    uint64_t duration;
+    bool found = commission(count, frames, duration);
+    printf("  %7d  %6u  %13.1f  %8.1f%s\n", count, frames, (double)frames / count, seconds(duration),
+           found ? "" : "  FAILED");
+    ok = ok && found;
+    if (count < maxDevices && count * 2 > maxDevices)
+      count = maxDevices / 2;
+  }
+
+  printf("\n%.1f s simulated in %.1f s\n", seconds(DaliSim.now), (double)(clock() - wall) / CLOCKS_PER_SEC);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,349 @@
+/** @file dali_trace.cpp
+ *  decode and replay binary bus traces of DaliTrace
+ *
+ *  usage: dali_trace print FILE           print the trace as DALI commands
+ *         dali_trace replay FILE [SPEED]  feed the frames of the trace through the decoder of the library on the
+ *                                         simulated bus, with pauses between frames shortened by SPEED
+ *         dali_trace capture FILE [S]     record S simulated seconds (default 60) of sample traffic
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "Arduino.h"
+#include "DaliSim.h"
+#include "Dali.h"
+#include "DaliTrace.h"
+#include "DaliEvents.h"
+
+struct traceEntry {
+  uint64_t time; // µs since the first record
+  daliTraceRecord record;
+};
+
+struct commandName {
+  uint16_t command;
+  uint8_t count; // commands from command to command + count - 1, numbered
+  const char * name;
+};
+
+#define NAME(command) { command, 1, #command }
+#define NAMES(command, count) { command, count, #command }
+
+static const commandName commandNames[] = {
+  NAME(OFF), NAME(UP), NAME(DOWN), NAME(STEP_UP), NAME(STEP_DOWN), NAME(RECALL_MAX), NAME(RECALL_MIN),
+  NAME(STEP_DOWN_AND_OFF), NAME(ON_AND_STEP_UP), NAME(GO_TO_LAST), NAMES(GO_TO_SCENE, 16),
+  NAME(DEVICE_RESET), NAME(ARC_TO_DTR), NAME(SAVE_VARS), NAME(SET_OPMODE), NAME(RESET_MEM), NAME(IDENTIFY),
+  NAME(DTR_AS_MAX), NAME(DTR_AS_MIN), NAME(DTR_AS_FAIL), NAME(DTR_AS_POWER_ON), NAME(DTR_AS_FADE_TIME),
+  NAME(DTR_AS_FADE_RATE), NAME(DTR_AS_EXT_FADE_TIME), NAMES(DTR_AS_SCENE, 16), NAMES(REMOVE_FROM_SCENE, 16),
+  NAMES(ADD_TO_GROUP, 16), NAMES(REMOVE_FROM_GROUP, 16), NAME(DTR_AS_SHORT), NAME(ENABLE_WRITE_MEM),
+  NAME(QUERY_STATUS), NAME(QUERY_BALLAST), NAME(QUERY_LAMP_FAILURE), NAME(QUERY_LAMP_POWER_ON),
+  NAME(QUERY_LIMIT_ERROR), NAME(QUERY_RESET_STATE), NAME(QUERY_MISSING_SHORT), NAME(QUERY_VERSION), NAME(QUERY_DTR),
+  NAME(QUERY_DEVICE_TYPE), NAME(QUERY_PHYS_MIN), NAME(QUERY_POWER_FAILURE), NAME(QUERY_OPMODE), NAME(QUERY_LIGHTTYPE),
+  NAME(QUERY_ACTUAL_LEVEL), NAME(QUERY_MAX_LEVEL), NAME(QUERY_MIN_LEVEL), NAME(QUERY_POWER_ON_LEVEL),
+  NAME(QUERY_FAIL_LEVEL), NAME(QUERY_FADE_SPEEDS), NAME(QUERY_SPECMODE), NAME(QUERY_NEXT_DEVTYPE),
+  NAME(QUERY_EXT_FADE_TIME), NAME(QUERY_CTRL_GEAR_FAIL), NAMES(QUERY_SCENE_LEVEL, 16), NAME(QUERY_GROUPS_0_7),
+  NAME(QUERY_GROUPS_8_15), NAME(QUERY_ADDRH), NAME(QUERY_ADDRM), NAME(QUERY_ADDRL), NAME(READ_MEM_LOC),
+};
+
+static const commandName specialNames[] = {
+  NAME(TERMINATE), NAME(SET_DTR), NAME(INITIALISE), NAME(RANDOMISE), NAME(COMPARE), NAME(WITHDRAW),
+  NAME(SEARCHADDRH), NAME(SEARCHADDRM), NAME(SEARCHADDRL), NAME(PROGRAMSHORT), NAME(VERIFYSHORT), NAME(QUERY_SHORT),
+  NAME(PHYS_SEL), NAME(ENABLE_DT), NAME(SET_DTR1), NAME(SET_DTR2), NAME(WRITE_MEM_LOC), NAME(WRITE_MEM_LOC_NOREPLY),
+};
+
+static const commandName dt8Names[] = {
+  NAME(SET_COORDINATE_X), NAME(SET_COORDINATE_Y), NAME(ACTIVATE), NAME(STEP_UP_COORDINATE_X),
+  NAME(STEP_DOWN_COORDINATE_X), NAME(STEP_UP_COORDINATE_Y), NAME(STEP_DOWN_COORDINATE_Y),
+  NAME(SET_TEMP_COLOUR_TEMPERATURE), NAME(STEP_COOLER_COLOUR_TEMPERATURE), NAME(STEP_WARMER_COLOUR_TEMPERATURE),
+  NAME(SET_TEMP_PRIMARY_LEVEL), NAME(SET_TEMP_RGB_LEVEL), NAME(SET_TEMP_WAF_LEVEL), NAME(SET_TEMP_RGBWAF_LEVEL),
+  NAME(COPY_REPORT_TO_TEMP), NAME(STORE_TY_PRIMARY), NAME(STORE_XY_COORDINATE_PRIMARY),
+  NAME(STORE_COLOUR_TEMPERATURE_LIMIT), NAME(STORE_GEAR_FEATURES), NAME(ASSIGN_COLOUR_TO_LINKED_CHANNEL),
+  NAME(START_AUTO_CALIBRATION), NAME(QUERY_GEAR_FEATURES), NAME(QUERY_COLOUR_STATUS), NAME(QUERY_COLOUR_TYPE_FEATURES),
+  NAME(QUERY_COLOUR_VALUE), NAME(QUERY_COLOUR_RGBWAF_CONTROL), NAME(QUERY_COLOUR_ASSIGNED_COLOUR),
+  NAME(QUERY_EXTENDED_VERSION_NUMBER),
+};
+
+static const char * errorNames[DALI_STATS_ERRORS] = {
+  "NO_ERROR", "RX_EMPTY", "RX_ERROR", "SENT", "INVALID_PARAMETER", "BUSY", "READY_TIMEOUT", "SEND_TIMEOUT",
+  "COLLISION", "PULLDOWN", "CANT_BE_HIGH", "INVALID_STARTBIT", "ERROR_TIMING", "PENDING", "ERROR_MANCHESTER",
+  "ERROR_LENGTH", "ERROR_OVERRUN",
+};
+
+template <size_t N>
+static void printName(const commandName (&names)[N], uint16_t command) {
+  for (size_t i = 0; i < N; i++)
+    if (command >= names[i].command && command < names[i].command + names[i].count) {
+      if (names[i].count > 1)
+        printf("%s %d", names[i].name, command - names[i].command);
+      else
+        printf("%s", names[i].name);
+      return;
+    }
+  printf("command %d", command);
+}
+
+static uint8_t enabledDeviceType = 0xFF; // ENABLE_DT applies to the next command only
+
+static void printForward(const uint8_t * data) {
+  uint8_t address = data[0], value = data[1];
+  uint8_t deviceType = enabledDeviceType;
+  enabledDeviceType = 0xFF;
+
+  if ((address & 0xE1) == 0xA1 || (address & 0xE1) == 0xC1) {
+    uint16_t command = 256 + ((address & 0x7E) >> 1) - 16;
+    printName(specialNames, command);
+    printf(" %d", value);
+    if (command == DaliSpecialCmd::ENABLE_DT)
+      enabledDeviceType = value;
+    return;
+  }
+
+  if (address >= 0xFE)
+    printf("broadcast ");
+  else if ((address & 0x80) == 0)
+    printf("short %d ", (address >> 1) & 0x3F);
+  else if ((address & 0xE0) == 0x80)
+    printf("group %d ", (address >> 1) & 0x0F);
+  else {
+    printf("reserved %02X %02X", address, value);
+    return;
+  }
+
+  if ((address & 1) == 0)
+    printf("ARC %d", value);
+  else if (deviceType == 8 && value >= 224)
+    printName(dt8Names, value);
+  else
+    printName(commandNames, value);
+}
+
+static void printEvent(const daliEvent & event) {
+  static const char * schemes[] = { "device", "device/instance", "device group", "instance", "instance group" };
+  printf("event %s", schemes[event.scheme]);
+  if (event.device != 0xFF)
+    printf(" %s %d", event.scheme == DALI_EVENT_DEVICE_GROUP ? "group" : "address", event.device);
+  if (event.instanceType != 0xFF)
+    printf(" type %d", event.instanceType);
+  if (event.instance != 0xFF)
+    printf(" %s %d", event.scheme == DALI_EVENT_INSTANCE_GROUP ? "instance group" : "instance", event.instance);
+  printf(" info 0x%03X", event.info);
+}
+
+static void printRecord(const traceEntry & entry) {
+  const daliTraceRecord & record = entry.record;
+  uint8_t type = record.type >> 5, bits = record.type & 0x1F;
+  static const char * types[] = { "start", "sent", "response", "received", "error", "dropped", "?", "?" };
+  printf("%12.6f  %-8s  ", entry.time / 1000000.0, types[type]);
+
+  switch (type) {
+    case DALI_TRACE_SENT:
+    case DALI_TRACE_RECEIVED: {
+      daliFrame frame;
+      daliEvent event;
+      frame.bits = bits;
+      frame.error = DALI_NO_ERROR;
+      memcpy(frame.data, record.data, 3);
+      if (bits == 16)
+        printForward(record.data);
+      else if (DaliEvents::decode(frame, event))
+        printEvent(event);
+      else if (bits == 8)
+        printf("answer %d (0x%02X)", record.data[0], record.data[0]);
+      else
+        printf("%d bit frame %02X %02X %02X", bits, record.data[0], record.data[1], record.data[2]);
+      break;
+    }
+    case DALI_TRACE_RESPONSE:
+      printf("answer %d (0x%02X)", record.data[0], record.data[0]);
+      break;
+    case DALI_TRACE_ERROR:
+      printf("%s%s", record.data[0] < DALI_STATS_ERRORS ? errorNames[record.data[0]] : "?",
+             record.data[1] ? "" : " (received)");
+      if (record.data[2])
+        printf(" after %d bits", record.data[2]);
+      break;
+    case DALI_TRACE_DROPPED:
+      printf("%lu records", ((unsigned long)record.data[0] << 16) | (record.data[1] << 8) | record.data[2]);
+      break;
+  }
+  printf("\n");
+}
+
+// read all records, unwrap their timestamps and sort them, as own frames are recorded once completed
+static bool load(const char * path, std::vector<traceEntry> & entries) {
+  FILE * file = fopen(path, "rb");
+  if (file == nullptr) {
+    perror(path);
+    return false;
+  }
+
+  traceEntry entry;
+  uint32_t last = 0;
+  uint64_t time = 0;
+  while (fread(&entry.record, sizeof(entry.record), 1, file) == 1) {
+    int32_t delta = (int32_t)(entry.record.timestamp - last);
+    if (!entries.empty())
+      time += (delta < 0 && delta > -1000000) ? delta : (int64_t)(uint32_t)delta;
+    last = entry.record.timestamp;
+    entry.time = time;
+    entries.push_back(entry);
+  }
+  fclose(file);
+
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const traceEntry & a, const traceEntry & b) { return a.time < b.time; });
+  return true;
+}
+
+static int print(const char * path) {
+  std::vector<traceEntry> entries;
+  if (!load(path, entries)) return 1;
+  for (const traceEntry & entry : entries)
+    printRecord(entry);
+  return 0;
+}
+
+static bool isFrame(const daliTraceRecord & record) {
+  uint8_t type = record.type >> 5;
+  return type == DALI_TRACE_SENT || type == DALI_TRACE_RESPONSE || type == DALI_TRACE_RECEIVED;
+}
+
+static int replay(const char * path, double speed) {
+  std::vector<traceEntry> entries;
+  if (!load(path, entries)) return 1;
+
+  // the frames are sent by a second interface and decoded by DaliBus
+  DaliSimBus bus;
+  DaliBusClass injector;
+  DaliSim.connect(bus, 2, 3);
+  DaliSim.connect(bus, 4, 5);
+  DaliBus.begin(2, 3);
+  injector.begin(4, 5);
+  DaliSim.run(100000);
+
+  std::vector<const traceEntry *> frames;
+  for (const traceEntry & entry : entries)
+    if (isFrame(entry.record))
+      frames.push_back(&entry);
+
+  clock_t wall = clock();
+  uint64_t start = DaliSim.now;
+  size_t sent = 0, decoded = 0, matched = 0;
+  while (decoded < frames.size()) {
+    if (sent < frames.size() && DaliSim.now - start >= frames[sent]->time / speed && injector.txQueueFree() > 0) {
+      const daliTraceRecord & record = frames[sent]->record;
+      uint8_t bits = record.type & 0x1F;
+      if (injector.sendRaw(record.data, bits) == DALI_SENT)
+        sent++;
+    }
+    injector.loop();
+
+    daliFrame frame;
+    while (DaliBus.receive(frame)) {
+      const daliTraceRecord & record = frames[decoded]->record;
+      if (frame.error == DALI_NO_ERROR && frame.bits == (record.type & 0x1F) &&
+          memcmp(frame.data, record.data, (frame.bits + 7) / 8 > 3 ? 3 : (frame.bits + 7) / 8) == 0)
+        matched++;
+      else {
+        printf("mismatch: ");
+        printRecord(*frames[decoded]);
+      }
+      decoded++;
+    }
+    if (sent == decoded && sent < frames.size() && frames[sent]->time / speed > DaliSim.now - start + 100000)
+      DaliSim.runUntil(start + frames[sent]->time / speed - 100000); // skip pauses quickly
+    else
+      DaliSim.run(100);
+  }
+
+  double wallTime = (double)(clock() - wall) / CLOCKS_PER_SEC;
+  double simTime = (DaliSim.now - start) / 1000000.0;
+  printf("%zu frames replayed, %zu decoded correctly\n", frames.size(), matched);
+  printf("%.1f s of bus traffic in %.2f s (%.0fx real time)\n", simTime, wallTime,
+         wallTime > 0 ? simTime / wallTime : 0);
+  return matched == frames.size() ? 0 : 1;
+}
+
+// file sink for DaliTrace::write()
+class FilePrint : public Print {
+  public:
+    FilePrint(FILE * output) : file(output) {}
+    size_t write(uint8_t value) { return fwrite(&value, 1, 1, file); }
+    size_t write(const uint8_t * buffer, size_t size) { return fwrite(buffer, 1, size, file); }
+  protected:
+    FILE * file;
+};
+
+// commission four devices, then poll them while another master switches them
+static int capture(const char * path, uint64_t duration) {
+  FILE * file = fopen(path, "wb");
+  if (file == nullptr) {
+    perror(path);
+    return 1;
+  }
+  FilePrint out(file);
+
+  DaliSimBus bus;
+  DaliSimGear gear[4];
+  DaliBusClass otherBus;
+  DaliClass other(otherBus);
+  DaliTrace trace;
+  DaliSim.connect(bus, 2, 3);
+  DaliSim.connect(bus, 4, 5);
+  Dali.begin(2, 3);
+  other.begin(4, 5);
+  for (uint8_t i = 0; i < 4; i++) {
+    gear[i].factoryReset();
+    bus.add(gear[i]);
+  }
+  DaliSim.run(100000);
+  trace.begin();
+
+  uint64_t start = DaliSim.now;
+  Dali.commission();
+  while (Dali.commissionState != DaliClass::COMMISSION_OFF) {
+    Dali.commission_tick();
+    Dali.loop();
+    trace.write(out);
+    DaliSim.run(100);
+  }
+
+  for (uint32_t tick = 0; DaliSim.now - start < duration; tick++) {
+    if (tick % 10 == 0)
+      Dali.sendCmdAsync(tick / 10 % 4, DaliCmd::QUERY_ACTUAL_LEVEL);
+    if (tick % 50 == 0)
+      other.sendArcAsync(tick / 50 % 4, tick % 100 ? 254 : 0);
+    for (uint8_t i = 0; i < 100; i++) {
+      Dali.loop();
+      other.loop();
+      DaliSim.run(100);
+    }
+    trace.write(out);
+  }
+  while (!DaliBus.busIsIdle()) {
+    Dali.loop();
+    DaliSim.run(1000);
+  }
+  Dali.loop();
+  trace.write(out);
+  fclose(file);
+
+  printf("%lu records dropped\n", (unsigned long)trace.dropped);
+  return 0;
+}
+
+int main(int argc, char ** argv) {
+  if (argc >= 3 && strcmp(argv[1], "print") == 0)
+    return print(argv[2]);
+  if (argc >= 3 && strcmp(argv[1], "replay") == 0)
+    return replay(argv[2], argc > 3 ? atof(argv[3]) : 1.0);
+  if (argc >= 3 && strcmp(argv[1], "capture") == 0)
+    return capture(argv[2], (argc > 3 ? atoi(argv[3]) : 60) * 1000000ULL);
+
+  fprintf(stderr, "usage: %s print FILE | replay FILE [SPEED] | capture FILE [SECONDS]\n", argv[0]);
+  return 2;
+}
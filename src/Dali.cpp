@@ -33,40 +33,82 @@
   repeat: 32-128(-143), 258, 259, 
 */
 
-void DaliClass::begin(byte tx_pin, byte rx_pin, bool active_low) {
-  DaliBus.begin(tx_pin, rx_pin, active_low);
+bool DaliClass::begin(byte tx_pin, byte rx_pin, bool active_low) {
+  return bus.begin(tx_pin, rx_pin, active_low);
 }
 
 void DaliClass::setCallback(EventHandlerReceivedDataFuncPtr callback)
 {
-  DaliBus.receivedCallback = callback;
+  bus.receivedCallback = callback;
 }
 
+void DaliClass::loop()
+{
+  bus.loop();
+}
+
+void DaliClass::setMonitor(EventHandlerMonitorFuncPtr callback, void * context)
+{
+  bus.monitorContext = context;
+  bus.monitorCallback = callback;
+}
+
+#ifndef DALI_NO_STATS
+void DaliClass::getStats(daliBusStats & stats, bool reset)
+{
+  bus.getStats(stats, reset);
+}
+#endif
+
 void DaliClass::setActivityCallback(EventHandlerActivityFuncPtr callback)
 {
-  DaliBus.activityCallback = callback;
+  bus.activityCallback = callback;
 }
 
 int DaliClass::sendRawWait(const byte * message, uint8_t bits, byte timeout) {
   unsigned long time = millis();
+  daliFrameHandle handle;
   int result;
 
-  while (!DaliBus.busIsIdle())
+  while ((result = bus.sendRaw(message, bits, &handle)) == DALI_BUSY)
     if (millis() - time > timeout) return DALI_READY_TIMEOUT;
+  if (result != DALI_SENT) return result;
 
-  result = DaliBus.sendRaw(message, bits);
+  while ((result = bus.getResult(handle)) == DALI_PENDING)
+    if (millis() - time > timeout) return DALI_SEND_TIMEOUT;
 
-  while (!DaliBus.busIsIdle())
-    if (millis() - time > timeout) return DALI_READY_TIMEOUT;
+  return result;
+}
 
-  return (result != DALI_SENT) ? result : DaliBus.getLastResponse();
+DaliTransaction DaliClass::sendRawAsync(const byte * message, uint8_t bits, EventHandlerCompletedFuncPtr callback,
+                                        void * context) {
+  return sendAsync(message, bits, 1, callback, context);
 }
 
-byte * DaliClass::prepareCmd(byte * message, byte address, byte command, byte type, byte selector) {
-  message[0] = type << 7;
-  message[0] |= address << 1;
-  message[0] |= selector;
+DaliTransaction DaliClass::sendAsync(const byte * message, uint8_t bits, uint8_t count,
+                                     EventHandlerCompletedFuncPtr callback, void * context) {
+  if (count > 1) { // repeated frames need to be transmitted as a unit
+    DaliSequence sequence(*this);
+    while (count--)
+      sequence.raw(message, bits);
+    return sequence.send(callback, context);
+  }
+
+  daliFrameHandle handle;
+  daliReturnValue result = bus.sendRaw(message, bits, &handle);
+  if (result != DALI_SENT) return DaliTransaction(result);
 
+  if (callback != nullptr)
+    bus.onComplete(handle, callback, context);
+  return DaliTransaction(bus, handle);
+}
+
+daliFrame daliInvalidFrame() {
+  return daliFrame{ 0, 0, { 0, 0, 0 }, DALI_INVALID_PARAMETER };
+}
+
+byte * DaliClass::prepareCmd(byte * message, byte address, byte command, byte type, byte selector) {
+  message[0] = daliAddressByte(address, type, selector);
   message[1] = command;
   return message;  
 }
@@ -77,7 +119,9 @@ daliReturnValue DaliClass::sendArcBroadcast(byte value) {
 
 daliReturnValue DaliClass::sendArc(byte address, byte value, byte addr_type) {
   byte message[2];
-  return DaliBus.sendRaw(prepareCmd(message, address, value, addr_type, 0), 16);
+  prepareCmd(message, address, value, addr_type, 0);
+  if (coalesceArc && bus.supersedeArc(message[0], value)) return DALI_SENT;
+  return bus.sendRaw(message, 16);
 }
 
 daliReturnValue DaliClass::sendArcBroadcastWait(byte value, byte timeout) {
@@ -95,7 +139,7 @@ daliReturnValue DaliClass::sendCmdBroadcast(DaliCmd command) {
 
 daliReturnValue DaliClass::sendCmd(byte address, DaliCmd command, byte addr_type) {
   byte message[2];
-  return DaliBus.sendRaw(prepareCmd(message, address, command, addr_type, 1), 16);
+  return bus.sendRaw(prepareCmd(message, address, command, addr_type, 1), 16);
 }
 
 int DaliClass::sendCmdBroadcastWait(DaliCmd command, byte timeout) {
@@ -103,24 +147,16 @@ int DaliClass::sendCmdBroadcastWait(DaliCmd command, byte timeout) {
 }
 
 int DaliClass::sendCmdWait(byte address, DaliCmd command, byte addr_type, byte timeout) {
-  byte sendCount = (command > 32 && command < 143) ? 2 : 1; // config commands need to be sent twice
-
   byte message[2];
-  int result;
-
-  while (sendCount) {
-    result = sendRawWait(prepareCmd(message, address, command, addr_type, 1), 2, timeout);
-    if (result != DALI_RX_EMPTY) return result;
-    sendCount--;
-  }
+  prepareCmd(message, address, command, addr_type, 1);
+  if (sendCount(command) == 1)
+    return sendRawWait(message, 16, timeout);
 
-  return result;
+  return DaliSequence(*this).cmd(address, command, addr_type).sendWait(timeout, 0);
 }
 
 byte * DaliClass::prepareSpecialCmd(byte * message, word command, byte value) {
-  message[0] = ((byte) command + 16) << 1; // convert command number
-  message[0] |= 0b10000001;                // to special command byte
-
+  message[0] = daliSpecialByte(command);
   message[1] = value;
   return message;
 }
@@ -129,7 +165,7 @@ daliReturnValue DaliClass::sendSpecialCmd(DaliSpecialCmd cmd, byte value) {
   word command = static_cast<word>(cmd);
   if (command < 256 || command > 287) return DALI_INVALID_PARAMETER;
   byte message[2];
-  return DaliBus.sendRaw(prepareSpecialCmd(message, command, value), 16);
+  return bus.sendRaw(prepareSpecialCmd(message, command, value), 16);
 }
 
 int DaliClass::sendSpecialCmdWait(word command, byte value, byte timeout) {
@@ -137,23 +173,173 @@ int DaliClass::sendSpecialCmdWait(word command, byte value, byte timeout) {
   return sendRawWait(prepareSpecialCmd(message, command, value), 16);
 }
 
+DaliTransaction DaliClass::sendArcAsync(byte address, byte value, byte addr_type,
+                                        EventHandlerCompletedFuncPtr callback, void * context) {
+  byte message[2];
+  prepareCmd(message, address, value, addr_type, 0);
+  daliFrameHandle handle;
+  if (coalesceArc && bus.supersedeArc(message[0], value, &handle)) {
+    if (callback != nullptr)
+      bus.onComplete(handle, callback, context);
+    return DaliTransaction(bus, handle);
+  }
+  return sendAsync(message, 16, 1, callback, context);
+}
+
+DaliTransaction DaliClass::sendCmdAsync(byte address, DaliCmd command, byte addr_type,
+                                        EventHandlerCompletedFuncPtr callback, void * context) {
+  byte message[2];
+  return sendAsync(prepareCmd(message, address, command, addr_type, 1), 16, sendCount(command), callback, context);
+}
+
+DaliTransaction DaliClass::sendSpecialCmdAsync(DaliSpecialCmd cmd, byte value,
+                                               EventHandlerCompletedFuncPtr callback, void * context) {
+  word command = static_cast<word>(cmd);
+  if (command < 256 || command > 287) return DaliTransaction(DALI_INVALID_PARAMETER);
+  byte sendCount = (daliSpecialCmdFlags(command) & DALI_CMD_TWICE) ? 2 : 1;
+  byte message[2];
+  return sendAsync(prepareSpecialCmd(message, command, value), 16, sendCount, callback, context);
+}
+
+DaliSequence & DaliSequence::add(const byte * message, uint8_t bits, uint8_t times) {
+  while (times--) {
+    if (count == DALI_SEQUENCE_SIZE) {
+      valid = false;
+      break;
+    }
+    daliFrame &frame = frames[count++];
+    frame.bits = bits;
+    for (byte i = 0; i < 3; i++)
+      frame.data[i] = i < (bits + 7) / 8 ? message[i] : 0;
+  }
+  return *this;
+}
+
+DaliSequence & DaliSequence::arc(byte address, byte value, byte addr_type) {
+  byte message[2];
+  return add(dali.prepareCmd(message, address, value, addr_type, 0), 16);
+}
+
+DaliSequence & DaliSequence::cmd(byte address, DaliCmd command, byte addr_type) {
+  byte message[2];
+  return add(dali.prepareCmd(message, address, command, addr_type, 1), 16, DaliClass::sendCount(command));
+}
+
+DaliSequence & DaliSequence::special(DaliSpecialCmd cmd, byte value) {
+  word command = static_cast<word>(cmd);
+  if (command < 256 || command > 287) {
+    valid = false;
+    return *this;
+  }
+  byte message[2];
+  byte times = (daliSpecialCmdFlags(command) & DALI_CMD_TWICE) ? 2 : 1;
+  return add(dali.prepareSpecialCmd(message, command, value), 16, times);
+}
+
+DaliSequence & DaliSequence::raw(const byte * message, uint8_t bits) {
+  return add(message, bits);
+}
+
+DaliSequence & DaliSequence::dtr(uint8_t reg, byte value) {
+  static const DaliSpecialCmd commands[3] = { DaliSpecialCmd::SET_DTR, DaliSpecialCmd::SET_DTR1, DaliSpecialCmd::SET_DTR2 };
+  if (reg > 2) {
+    valid = false;
+    return *this;
+  }
+  return special(commands[reg], value);
+}
+
+DaliSequence & DaliSequence::reuseDtr(bool enable) {
+  reuse = enable;
+  return *this;
+}
+
+DaliSequence & DaliSequence::requireDtrs(uint8_t epoch) {
+  dtrEpoch = epoch;
+  return *this;
+}
+
+DaliSequence & DaliSequence::clear() {
+  count = 0;
+  valid = true;
+  return *this;
+}
+
+DaliTransaction DaliSequence::send(EventHandlerCompletedFuncPtr callback, void * context) {
+  if (!valid || count == 0) return DaliTransaction(DALI_INVALID_PARAMETER);
+
+  daliFrameHandle handle;
+  daliReturnValue result = dali.bus.sendSequence(frames, count, &handle, reuse, dtrEpoch);
+  if (result != DALI_SENT) return DaliTransaction(result);
+
+  if (callback != nullptr)
+    dali.bus.onComplete(handle, callback, context);
+  return DaliTransaction(dali.bus, handle);
+}
+
+int DaliSequence::sendWait(byte timeout, uint8_t retries) {
+  while (true) {
+    unsigned long time = millis();
+    unsigned long limit = (unsigned long)timeout * count;
+    DaliTransaction transaction;
+    while ((transaction = send()).result() == DALI_BUSY)
+      if (millis() - time > limit) return DALI_READY_TIMEOUT;
+
+    int result;
+    while ((result = transaction.result()) == DALI_PENDING)
+      if (millis() - time > limit) return DALI_SEND_TIMEOUT;
+    if (result != DALI_COLLISION || retries-- == 0)
+      return result;
+  }
+}
+
 #ifndef DALI_NO_COMMISSIONING
 void DaliClass::commission(byte startAddress, bool onlyNew) {
   nextShortAddress = startAddress;
   commissionOnlyNew = onlyNew;
-  
+  searchLow = 0;
+  searchSentValid = 0; // search address of devices is unknown
+
   // start commissioning
   commissionState = COMMISSION_INIT;
 }
 
+void DaliClass::searchNextBit() {
+  // compare with current bit cleared and all lower bits set, unless no remaining device can be that low
+  while (searchBit > 0) {
+    searchBit--;
+    uint32_t candidate = searchPrefix | ((1UL << searchBit) - 1);
+    if (candidate >= searchLow) {
+      searchAddress = candidate;
+      commissionState = COMMISSION_SEARCHHIGH;
+      return;
+    }
+    searchPrefix |= 1UL << searchBit;
+  }
+
+  // all bits known, if no device responded yet it still needs to be confirmed by a final compare
+  searchBit = -1;
+  searchAddress = searchPrefix;
+  commissionState = COMMISSION_SEARCHHIGH;
+}
+
+bool DaliClass::sendSearchAddress(DaliSpecialCmd command, byte shift) {
+  byte value = (searchAddress >> shift) & 0xFF;
+  byte validBit = 1 << (shift / 8);
+  if ((searchSentValid & validBit) && ((searchSent >> shift) & 0xFF) == value)
+    return false;
+
+  sendSpecialCmd(command, value);
+  searchSent = (searchSent & ~(0xFFUL << shift)) | ((uint32_t)value << shift);
+  searchSentValid |= validBit;
+  return true;
+}
+
 void DaliClass::commission_tick() {
   // TODO: set timeout for commissioning?
   // TODO: also clear group addresses?
 
-  static byte searchIterations;
-  static unsigned long currentSearchAddress;
-
-  if (DaliBus.busIsIdle()) { // wait until bus is idle
+  if (bus.busIsIdle()) { // wait until bus is idle
     switch (commissionState) {
       case COMMISSION_INIT:
         sendSpecialCmd(DaliSpecialCmd::INITIALISE, (commissionOnlyNew ? 255 : 0));
@@ -184,52 +370,47 @@ void DaliClass::commission_tick() {
         commissionState = COMMISSION_RANDOMWAIT;
         break;
       case COMMISSION_RANDOMWAIT:  // wait 100ms for random address to generate
-        if (DaliBus.busIdleCount >= 255)
+        if (bus.idleTime() >= 100000)
           commissionState = COMMISSION_STARTSEARCH;
         break;
-      case COMMISSION_STARTSEARCH:
-        searchIterations = 0;
-        currentSearchAddress = 0xFFFFFF;
-      case COMMISSION_SEARCHHIGH:
-        sendSpecialCmd(DaliSpecialCmd::SEARCHADDRH, (currentSearchAddress >> 16) & 0xFF);
+      case COMMISSION_STARTSEARCH:  // bitwise search for lowest random address above the last one found
+        if (searchLow > 0xFFFFFF) {   // last device found had the highest possible address
+          commissionState = COMMISSION_TERMINATE;
+          break;
+        }
+        searchPrefix = 0;
+        searchBit = 24;
+        searchFound = false;
+        searchNextBit();
+        // fall through
+      case COMMISSION_SEARCHHIGH:   // only send search address bytes that have changed
         commissionState = COMMISSION_SEARCHMID;
-        break;
+        if (sendSearchAddress(DaliSpecialCmd::SEARCHADDRH, 16))
+          break;
+        // fall through
       case COMMISSION_SEARCHMID:
-        sendSpecialCmd(DaliSpecialCmd::SEARCHADDRM, (currentSearchAddress >> 8) & 0xFF);
         commissionState = COMMISSION_SEARCHLOW;
-        break;
+        if (sendSearchAddress(DaliSpecialCmd::SEARCHADDRM, 8))
+          break;
+        // fall through
       case COMMISSION_SEARCHLOW:
-        sendSpecialCmd(DaliSpecialCmd::SEARCHADDRL, (currentSearchAddress) & 0xFF);
-        commissionState = COMMISSION_COMPARE;
+        commissionState = (searchBit < 0 && searchFound) ? COMMISSION_PROGRAMSHORT : COMMISSION_COMPARE;
+        sendSearchAddress(DaliSpecialCmd::SEARCHADDRL, 0);
         break;
       case COMMISSION_COMPARE:
         sendSpecialCmd(DaliSpecialCmd::COMPARE);
         commissionState = COMMISSION_CHECKFOUND;
         break;
       case COMMISSION_CHECKFOUND:
-        {  // create scope for response variable
-        int response = DaliBus.getLastResponse();
-        if (response != DALI_RX_EMPTY)
-          if (searchIterations >= 24) // ballast found
-            commissionState = COMMISSION_PROGRAMSHORT;
-          else {
-            currentSearchAddress -= (0x800000 >> searchIterations);
-            commissionState = COMMISSION_SEARCHHIGH;
-          }
-        else
-          if (searchIterations == 0 || searchIterations > 24) // no device at all responded or error
-            commissionState = COMMISSION_TERMINATE;
-          else if (searchIterations == 24) {  // device responded before, but didn't now, so address is one higher
-            currentSearchAddress++;           // and for the device to act at upcoming commands, we need to send the actual address
-            commissionState = COMMISSION_SEARCHHIGH;
-          }
-          else {  // there's a device that didn't respond anymore, increase address
-            currentSearchAddress += (0x800000 >> searchIterations);
-            commissionState = COMMISSION_SEARCHHIGH;
-          }
-        searchIterations++;
+        if (bus.getLastResponse() != DALI_RX_EMPTY) // at least one device at or below search address
+          searchFound = true;
+        else if (searchBit < 0) {                       // final check, no device left
+          commissionState = COMMISSION_TERMINATE;
+          break;
+        } else
+          searchPrefix |= 1UL << searchBit;
+        searchNextBit();
         break;
-        }
       case COMMISSION_PROGRAMSHORT:
         sendSpecialCmd(DaliSpecialCmd::PROGRAMSHORT, (nextShortAddress << 1) | 1);
         commissionState = COMMISSION_VERIFYSHORT;
@@ -239,7 +420,7 @@ void DaliClass::commission_tick() {
         commissionState = COMMISSION_VERIFYSHORTRESPONSE;
         break;
       case COMMISSION_VERIFYSHORTRESPONSE:
-        if (DaliBus.getLastResponse() == 0xFF) {
+        if (bus.getLastResponse() == 0xFF) {
           nextShortAddress++;
           commissionState = COMMISSION_WITHDRAW;
         } else
@@ -248,6 +429,7 @@ void DaliClass::commission_tick() {
         break;
       case COMMISSION_WITHDRAW:
         sendSpecialCmd(DaliSpecialCmd::WITHDRAW);
+        searchLow = searchAddress + 1; // remaining devices have higher random addresses
         commissionState = COMMISSION_STARTSEARCH;
         break;
       case COMMISSION_TERMINATE:
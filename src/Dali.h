@@ -41,25 +41,75 @@
 #ifndef DALI_H
 #define DALI_H
 
-#include <arduino.h>
+#include <Arduino.h>
 #include "DaliBus.h"
 #include "DaliCommands.h"
 
+/** Address byte of a forward frame
+  * @param address    short address (0-63), group (0-15) or 0xFF for broadcast
+  * @param addr_type  ::DaliAddressTypes
+  * @param selector   0 for direct arc power, 1 for commands */
+constexpr uint8_t daliAddressByte(byte address, byte addr_type, byte selector) {
+  return (uint8_t)(address == 0xFF ? 0xFE | selector : addr_type << 7 | address << 1 | selector);
+}
+
+/** Address byte of a special command (256-287) */
+constexpr uint8_t daliSpecialByte(word command) {
+  return (uint8_t)((command - 256 + 16) << 1 | 0x81);
+}
+
+constexpr bool daliAddressValid(byte address, byte addr_type) {
+  return address == 0xFF || address < (addr_type == DaliAddressTypes::SHORT ? 64 : 16);
+}
+
+/** Result of the frame builders below for invalid arguments. Not constexpr, so using a frame built from constant
+  * arguments out of range in a constant expression doesn't compile; at run time the frame has 0 bits and is rejected
+  * with DALI_INVALID_PARAMETER when queued. */
+daliFrame daliInvalidFrame();
+
+/** Direct arc power frame, e.g. for DaliBusClass::sendSequence(). Frames of a constexpr variable are built at
+  * compile time.
+  * @param address    short address (0-63), group (0-15) or 0xFF for broadcast
+  * @param level      arc power level
+  * @param addr_type  ::DaliAddressTypes */
+constexpr daliFrame daliArcFrame(byte address, byte level, byte addr_type = DaliAddressTypes::SHORT) {
+  return daliAddressValid(address, addr_type) ?
+    daliFrame{ 0, 16, { daliAddressByte(address, addr_type, 0), level, 0 }, DALI_NO_ERROR } : daliInvalidFrame();
+}
+
+/** Command frame, see daliArcFrame(). Configuration commands need to be sent twice within 100 ms. */
+constexpr daliFrame daliCmdFrame(byte address, DaliCmd command, byte addr_type = DaliAddressTypes::SHORT) {
+  return daliAddressValid(address, addr_type) ?
+    daliFrame{ 0, 16, { daliAddressByte(address, addr_type, 1), (uint8_t)command, 0 }, DALI_NO_ERROR } :
+    daliInvalidFrame();
+}
+
+/** Special command frame, see daliArcFrame() */
+constexpr daliFrame daliSpecialFrame(DaliSpecialCmd command, byte value = 0) {
+  return command >= 256 && command <= 287 ?
+    daliFrame{ 0, 16, { daliSpecialByte(command), value, 0 }, DALI_NO_ERROR } : daliInvalidFrame();
+}
+
 /**
  * DALI library base class.
  */
 class DaliClass {
   public:
+    /** Create DALI instance
+      * @param bus_instance  low level bus to use, for multiple buses create a DaliBusClass for each of them */
+    DaliClass(DaliBusClass & bus_instance = DaliBus) : bus(bus_instance) {}
+
     /** Start the DALI bus
       * @param tx_pin       Pin to use for transmission
       * @param rx_pin       Pin to use for reception. Must support Pin Change Interrupt.
       * @param active_low  set to false if bus is active low
+      * @return false if more than #DALI_MAX_BUSES buses are started
       *
       * Initialize the hardware for DALI usage (i.e. set pin modes, timer and interrupts). By default the bus is
       * driven active-low, meaning with the µC tx pin being low the DALI bus will be high (idle). For transmission
       * the µC pin will be set high, which will pull the DALI voltage low. This behaviour
       * is used by most DALI hardware interfaces. The same logic applies to the rx pin. */
-    void begin(byte tx_pin, byte rx_pin, bool active_low = true);
+    bool begin(byte tx_pin, byte rx_pin, bool active_low = true);
 
     /** Send a direct arc level command
       * @param  address    destination address
@@ -68,8 +118,11 @@ class DaliClass {
       * @return ::daliReturnValue 
       *
       * This methods sends a "direct arc power control command" to the bus
-      * It doesn't check if the bus is ready and returns immediately, stating if transmission could be
-      * initiated through its response value ::daliReturnValue. */
+      * The frame is queued and the method returns immediately, stating if it could be queued through its
+      * response value ::daliReturnValue (DALI_BUSY if the transmit queue is full).
+      *
+      * With #coalesceArc a frame to the same address still waiting in the queue is updated to the new level instead,
+      * as long as no other frame queued after it could be affected by that. */
     daliReturnValue sendArc(byte address, byte value, byte addr_type = DaliAddressTypes::SHORT);
     daliReturnValue sendArcBroadcast(byte value);
 
@@ -80,7 +133,7 @@ class DaliClass {
       * @return ::daliReturnValue 
       *
       * This methods sends a "direct arc power control command" to the bus
-      * It uses sendRawWait(), so it waits for the bus to become idle before and after transmission. */
+      * It uses sendRawWait(), so it waits for the frame to be transmitted. */
     daliReturnValue sendArcWait(byte address, byte value, byte addr_type = DaliAddressTypes::SHORT, byte timeout = 50);
     daliReturnValue sendArcBroadcastWait(byte value, byte timeout = 50);
 
@@ -90,8 +143,8 @@ class DaliClass {
       * @param  addr_type  address type (short/group)
       * @return ::daliReturnValue 
       * This method sends a DALI Command to the bus (Commands from 0 to 255).
-      * It doesn't check if the bus is ready and returns immediately, stating if transmission could be
-      * initiated through its response value ::daliReturnValue.
+      * The frame is queued and the method returns immediately, stating if it could be queued through its
+      * response value ::daliReturnValue (DALI_BUSY if the transmit queue is full).
       * Note that some of the special commands need to be sent twice (258 - INITIALISE, 259 - RANDOMISE), which
       * this method doesn't do by itself. */
     daliReturnValue sendCmd(byte address, DaliCmd command, byte addr_type = DaliAddressTypes::SHORT);
@@ -101,8 +154,10 @@ class DaliClass {
       * @param  address    destination address
       * @param  command    DALI command
       * @param  addr_type  address type (short/group)
-      * @param  timeout    time in ms to wait for action to complete
-      * @return returns either the response, DALI_RX_EMPTY or any of ::daliReturnValue on error  */
+      * @param  timeout    time in ms to wait for action to complete, per frame for configuration commands
+      * @return returns either the response, DALI_RX_EMPTY or any of ::daliReturnValue on error
+      *
+      * Configuration commands are sent twice as a DaliSequence. */
     int sendCmdWait(byte address, DaliCmd command, byte addr_type = DaliAddressTypes::SHORT, byte timeout = 50);
     int sendCmdBroadcastWait(DaliCmd command, byte timeout = 50);
 
@@ -112,8 +167,8 @@ class DaliClass {
       * @return ::daliReturnValue  
       * 
       * This method sends a DALI Special Command to the bus (Special Commands are commands from 256 to 287).
-      * It doesn't check if the bus is ready and returns immediately, stating if transmission could be
-      * initiated through its response value ::daliReturnValue.
+      * The frame is queued and the method returns immediately, stating if it could be queued through its
+      * response value ::daliReturnValue (DALI_BUSY if the transmit queue is full).
       * Note that some of the special commands need to be sent twice (258 - INITIALISE, 259 - RANDOMISE), which
       * this method doesn't do by itself. */
     daliReturnValue sendSpecialCmd(DaliSpecialCmd command, byte value = 0);
@@ -125,7 +180,7 @@ class DaliClass {
       * @return returns either the response, DALI_RX_EMPTY or any of ::daliReturnValue on error
       * 
       * This method sends a DALI Special Command to the bus (Special Commands are commands from 256 to 287).
-      * It uses sendRawWait(), so it waits for the bus to become idle before and after transmission.
+      * It uses sendRawWait(), so it waits for the frame to be transmitted.
       * It returns either the received response, DALI_RX_EMPTY if no response has been received or any of
       * ::daliReturnValue if an error has occurred.
       * Note that some of the special commands need to be sent twice (258 - INITIALISE, 259 - RANDOMISE), which
@@ -138,13 +193,73 @@ class DaliClass {
       * @param timeout  time in ms to wait for action to complete
       *
       * This method sends a raw byte array of @p bits to the bus. The array can be three bytes max.
-      * It waits for the bus to become idle before and after transmission. It returns either the received response,
-      * DALI_RX_EMPTY if no response has been received or any of ::daliReturnValue if an error has occurred. */
+      * It queues the frame and waits for its transmission to complete. It returns either the received response,
+      * DALI_RX_EMPTY if no response has been received or any of ::daliReturnValue if an error has occurred
+      * (DALI_READY_TIMEOUT if the frame couldn't be queued, DALI_SEND_TIMEOUT if it wasn't completed in time). */
     int sendRawWait(const byte * message, uint8_t bits, byte timeout = 50);
 
-    /** Set Callback for receiving messages. */
+    /** Send a direct arc level command without waiting
+      * @param  address    destination address
+      * @param  value      arc level
+      * @param  addr_type  address type (short/group)
+      * @param  callback   optional, called from loop() once the frame has been completed
+      * @param  context    passed to @p callback
+      * @return DaliTransaction to poll or await, its result is DALI_BUSY if the transmit queue is full
+      *
+      * Pending frames without callback are updated like with sendArc(), the transaction then completes with that frame. */
+    DaliTransaction sendArcAsync(byte address, byte value, byte addr_type = DaliAddressTypes::SHORT,
+                                 EventHandlerCompletedFuncPtr callback = nullptr, void * context = nullptr);
+
+    /** Send a DALI command without waiting
+      * @param  address    destination address
+      * @param  command    DALI command
+      * @param  addr_type  address type (short/group)
+      * @param  callback   optional, called from loop() once the command has been completed
+      * @param  context    passed to @p callback
+      * @return DaliTransaction to poll or await, its result is the response, DALI_RX_EMPTY or any of
+      *         ::daliReturnValue on error (DALI_BUSY if the transmit queue is full)
+      *
+      * Configuration commands are queued twice, the transaction completes with the second frame. */
+    DaliTransaction sendCmdAsync(byte address, DaliCmd command, byte addr_type = DaliAddressTypes::SHORT,
+                                 EventHandlerCompletedFuncPtr callback = nullptr, void * context = nullptr);
+
+    /** Send a DALI special command without waiting
+      * @param  command   DALI special command
+      * @param  value     Value (2nd byte)
+      * @param  callback  optional, called from loop() once the command has been completed
+      * @param  context   passed to @p callback
+      * @return DaliTransaction to poll or await, see sendCmdAsync()
+      *
+      * INITIALISE and RANDOMISE are queued twice. */
+    DaliTransaction sendSpecialCmdAsync(DaliSpecialCmd command, byte value = 0,
+                                        EventHandlerCompletedFuncPtr callback = nullptr, void * context = nullptr);
+
+    /** Send raw values to the DALI bus without waiting
+      * @param message   byte array to send
+      * @param bits      number of bits to send
+      * @param callback  optional, called from loop() once the frame has been completed
+      * @param context   passed to @p callback
+      * @return DaliTransaction to poll or await, see sendCmdAsync() */
+    DaliTransaction sendRawAsync(const byte * message, uint8_t bits,
+                                 EventHandlerCompletedFuncPtr callback = nullptr, void * context = nullptr);
+
+    /** Set Callback for receiving messages. It is called from loop(), not from interrupt context. */
     void setCallback(EventHandlerReceivedDataFuncPtr callback);
 
+    /** Hand received messages to the callback and call completion callbacks, needs to be called regularly from
+      * the main loop if callbacks are used or coroutines await a DaliTransaction. Alternatively received frames
+      * can be fetched with DaliBusClass::receive(). */
+    void loop();
+
+    /** Set Callback watching all frames on the bus, see DaliBusClass::monitorCallback. Like the receive callback it
+      * is called from loop(), which then consumes all received frames. */
+    void setMonitor(EventHandlerMonitorFuncPtr callback, void * context = nullptr);
+
+#ifndef DALI_NO_STATS
+    /** Get bus statistics, see DaliBusClass::getStats() */
+    void getStats(daliBusStats & stats, bool reset = false);
+#endif
+
     /** Set Callback for activity. */
     void setActivityCallback(EventHandlerActivityFuncPtr callback);
 
@@ -159,8 +274,12 @@ class DaliClass {
       * all ballasts are removed. Then all found ballasts are assigned a new short address, starting
       * from @p startAddress. Commissioning has finished when @p commissionState is set back to COMMISSION_OFF.
       * The number of ballasts found can be determined from #nextShortAddress.
+      * Ballasts are searched bit by bit in ascending order of their random address. Bits for which the address of
+      * the last ballast found already rules out a match are skipped, and only search address bytes that have changed
+      * are sent.
       * With @p onlyNew = true ballasts with a short address assigned are ignored. The caller is responsible
-      * for setting an appropriate value to @p startAddress. */
+      * for setting an appropriate value to @p startAddress. DaliCommissioner also finds free short addresses and
+      * resolves short addresses shared by several ballasts. */
     void commission(byte startAddress = 0, bool onlyNew = false);
     
     /** State machine ticker for commissioning. See commission(). */
@@ -172,6 +291,9 @@ class DaliClass {
     /** When true, only ballasts without short address set are commissioned. */
     bool commissionOnlyNew;
 
+    /** Update pending direct arc power frames to the same address instead of queueing another one, see sendArc() */
+    bool coalesceArc = true;
+
     /** commissioning state machine states */
     enum commissionStateEnum { 
       COMMISSION_OFF, COMMISSION_INIT, COMMISSION_INIT2, COMMISSION_WRITE_DTR, COMMISSION_REMOVE_SHORT, COMMISSION_REMOVE_SHORT2, COMMISSION_RANDOM, COMMISSION_RANDOM2, COMMISSION_RANDOMWAIT,
@@ -181,14 +303,109 @@ class DaliClass {
       COMMISSION_WITHDRAW, COMMISSION_TERMINATE
     };
     commissionStateEnum commissionState = COMMISSION_OFF; /**< current state of commissioning state machine */
+
+  protected:
+    uint32_t searchLow;        // lowest random address a device not yet found can have
+    uint32_t searchPrefix;     // random address bits found so far
+    int8_t searchBit;          // bit currently searched, -1 when all bits are known
+    uint32_t searchAddress;    // address to compare with
+    uint32_t searchSent;       // search address last sent to the devices
+    byte searchSentValid;      // bit mask of bytes in searchSent known to the devices (L, M, H)
+    bool searchFound;          // a device responded to compare in current search
+
+    /** Determine next address to compare with, see commission_tick() */
+    void searchNextBit();
+
+    /** Send byte of search address at @p shift if the devices don't have it already. Returns true if sent. */
+    bool sendSearchAddress(DaliSpecialCmd command, byte shift);
 #endif
 
   protected:
+    friend class DaliSequence;
+    friend class DaliMemory;
+    friend class DaliPoller;
+    DaliBusClass & bus;
+
+    /** Number of times @p command needs to be sent (configuration commands twice) */
+    static byte sendCount(DaliCmd command) { return (daliCmdFlags(command) & DALI_CMD_TWICE) ? 2 : 1; }
+
     /** Prepares a byte array for sending DALI commands */
     byte * prepareCmd(byte * message, byte address, byte command, byte type, byte selector);
     
     /** Prepares a byte array for sending DALI Special Commands */
     byte * prepareSpecialCmd(byte * message, word command, byte value);
+
+    /** Queue @p count copies of a frame, as a sequence if more than one, the transaction completes with the last one */
+    DaliTransaction sendAsync(const byte * message, uint8_t bits, uint8_t count,
+                              EventHandlerCompletedFuncPtr callback, void * context);
+};
+
+/** Frames that need to be transmitted as a unit, e.g. DTR writes followed by the command using them
+  *
+  * The frames are queued at once and sent back-to-back with the minimum settling time. If one of them can't be
+  * transmitted or another participant sends a frame in between, the rest isn't sent and the sequence fails with
+  * DALI_COLLISION (see DaliBusClass::sendSequence()). Commands that need to be sent twice are added twice.
+  * @code
+  * DaliSequence(Dali).special(DaliSpecialCmd::SET_DTR, 100).cmd(3, DaliCmd::DTR_AS_MAX).sendWait();
+  * @endcode */
+class DaliSequence {
+  public:
+    DaliSequence(DaliClass & dali_instance) : dali(dali_instance) {}
+
+    /** Add a direct arc power frame */
+    DaliSequence & arc(byte address, byte value, byte addr_type = DaliAddressTypes::SHORT);
+
+    /** Add a command, configuration commands are added twice */
+    DaliSequence & cmd(byte address, DaliCmd command, byte addr_type = DaliAddressTypes::SHORT);
+
+    /** Add a special command, INITIALISE and RANDOMISE are added twice */
+    DaliSequence & special(DaliSpecialCmd command, byte value = 0);
+
+    /** Add a raw frame (8, 16, 24 or 25 bits) */
+    DaliSequence & raw(const byte * message, uint8_t bits);
+
+    /** Add SET_DTR, SET_DTR1 or SET_DTR2
+      * @param reg    register (0-2)
+      * @param value  value to write */
+    DaliSequence & dtr(uint8_t reg, byte value);
+
+    /** Leave out DTR writes of registers already holding the value when sending, see DaliBusClass::sendSequence() */
+    DaliSequence & reuseDtr(bool enable = true);
+
+    /** Only send the frames if the DTRs still hold what has been written until DaliBusClass::dtrChanges() returned
+      * @p epoch, see DaliBusClass::sendSequence() */
+    DaliSequence & requireDtrs(uint8_t epoch);
+
+    /** Remove all frames */
+    DaliSequence & clear();
+
+    /** Number of frames */
+    uint8_t size() const { return count; }
+
+    /** Queue all frames, the sequence can be sent again once completed
+      * @param  callback  optional, called from loop() once the last frame has been completed
+      * @param  context   passed to @p callback
+      * @return DaliTransaction of the last frame, its result is DALI_BUSY if the transmit queue hasn't room for all
+      *         frames and DALI_INVALID_PARAMETER if the sequence is empty or more than #DALI_SEQUENCE_SIZE frames or
+      *         invalid frames have been added */
+    DaliTransaction send(EventHandlerCompletedFuncPtr callback = nullptr, void * context = nullptr);
+
+    /** Send and wait for completion, the whole sequence is sent again if it fails with DALI_COLLISION
+      * @param  timeout  time in ms to wait per frame and attempt
+      * @param  retries  maximum number of times to send again
+      * @return the result of the last frame, see DaliTransaction::result(), DALI_READY_TIMEOUT if it couldn't be
+      *         queued or DALI_SEND_TIMEOUT */
+    int sendWait(byte timeout = 50, uint8_t retries = 2);
+
+  protected:
+    DaliClass & dali;
+    daliFrame frames[DALI_SEQUENCE_SIZE];
+    uint8_t count = 0;
+    bool valid = true;
+    bool reuse = false;
+    int16_t dtrEpoch = -1;
+
+    DaliSequence & add(const byte * message, uint8_t bits, uint8_t times = 1);
 };
 
 /** Dali class instance for main usage (seems to be common Arduino Library style) */
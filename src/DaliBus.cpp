@@ -16,20 +16,21 @@
 */
 
 #include "DaliBus.h"
+#include "DaliTrace.h"
+#include "DaliEvents.h"
+#include "DaliCommands.h"
 
 #ifdef DALI_TIMER
 #if defined(ARDUINO_ARCH_RP2040)
 RPI_PICO_Timer timer2(DALI_TIMER);
-void __isr __time_critical_func(DaliBus_wrapper_pinchangeISR)() { DaliBus.pinchangeISR(); }
 #elif defined(ARDUINO_ARCH_ESP32)
 ESP32Timer timer2(DALI_TIMER);
-void IRAM_ATTR DaliBus_wrapper_pinchangeISR() { DaliBus.pinchangeISR(); }
 #elif defined(ARDUINO_ARCH_ESP8266)
 ESP8266Timer timer2(DALI_TIMER);
-void IRAM_ATTR DaliBus_wrapper_pinchangeISR() { DaliBus.pinchangeISR(); }
 #elif defined(ARDUINO_ARCH_STM32)
 STM32Timer timer2(DALI_TIMER);
-void DaliBus_wrapper_pinchangeISR() { DaliBus.pinchangeISR(); }
+#elif defined(DALI_HOST)
+HostTimer timer2(DALI_TIMER);
 #elif defined(ARDUINO_ARCH_AVR)
   #if DALI_TIMER==1
   #define timer2 ITimer1
@@ -38,14 +39,71 @@ void DaliBus_wrapper_pinchangeISR() { DaliBus.pinchangeISR(); }
   #else
   #define timer2 ITimer3
   #endif
-void DaliBus_wrapper_pinchangeISR() { DaliBus.pinchangeISR(); }
 #endif
 #endif
 
-void DaliBusClass::begin(byte tx_pin, byte rx_pin, bool active_low) {
+#ifndef DALI_NO_STATS
+  // account execution time of an interrupt handler started at getEdgeTime start
+  #define isrDone(start) { uint32_t ticks = getEdgeTime - (start); isrTicks += ticks; stats.isrCount++; if (ticks > isrTicksMax) isrTicksMax = ticks; }
+#else
+  #define isrDone(start)
+#endif
+
+// one pin change wrapper per bus, as attachInterrupt() doesn't pass any argument
+#if defined(ARDUINO_ARCH_RP2040)
+  #define DALI_PINCHANGE_WRAPPER(n) void __isr __time_critical_func(DaliBus_wrapper_pinchangeISR##n)() { DaliBusClass::instances[n]->pinchangeISR(); }
+#elif defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+  #define DALI_PINCHANGE_WRAPPER(n) void IRAM_ATTR DaliBus_wrapper_pinchangeISR##n() { DaliBusClass::instances[n]->pinchangeISR(); }
+#else
+  #define DALI_PINCHANGE_WRAPPER(n) void DaliBus_wrapper_pinchangeISR##n() { DaliBusClass::instances[n]->pinchangeISR(); }
+#endif
+
+DALI_PINCHANGE_WRAPPER(0)
+#if DALI_MAX_BUSES > 1
+DALI_PINCHANGE_WRAPPER(1)
+#endif
+#if DALI_MAX_BUSES > 2
+DALI_PINCHANGE_WRAPPER(2)
+#endif
+#if DALI_MAX_BUSES > 3
+DALI_PINCHANGE_WRAPPER(3)
+#endif
+
+static void (* const DaliBus_wrapper_pinchangeISR[DALI_MAX_BUSES])() = {
+  DaliBus_wrapper_pinchangeISR0,
+#if DALI_MAX_BUSES > 1
+  DaliBus_wrapper_pinchangeISR1,
+#endif
+#if DALI_MAX_BUSES > 2
+  DaliBus_wrapper_pinchangeISR2,
+#endif
+#if DALI_MAX_BUSES > 3
+  DaliBus_wrapper_pinchangeISR3,
+#endif
+};
+
+DaliBusClass * DaliBusClass::instances[DALI_MAX_BUSES];
+volatile uint8_t DaliBusClass::instanceCount = 0;
+volatile bool DaliBusClass::timerSleeping = false;
+// idle ticks since the last edge: stop bits (4 TE) plus the start of the settling time window of each priority, up to
+// 2 ticks are added at random so masters of the same priority don't always start at the same time
+const uint8_t DaliBusClass::settlingTicks[6] = { 40, 37, 40, 44, 47, 51 };
+
+bool DaliBusClass::begin(byte tx_pin, byte rx_pin, bool active_low) {
+  // register bus for timer and pin change dispatch
+  uint8_t index = 0;
+  while (index < instanceCount && instances[index] != this)
+    index++;
+  if (index == DALI_MAX_BUSES) return false;
+
   txPin = tx_pin;
   rxPin = rx_pin;
   activeLow = active_low;
+  ticksPerUs = getEdgeTicksPerUs;
+  txRandom = (micros() ^ ((uint16_t)tx_pin << 8) ^ rx_pin) | 1;
+#ifndef DALI_NO_STATS
+  resetStats();
+#endif
 
   // init bus state
   busState = IDLE;
@@ -57,89 +115,722 @@ void DaliBusClass::begin(byte tx_pin, byte rx_pin, bool active_low) {
   // RX pin setup
   pinMode(rxPin, INPUT);
 
-  attachInterrupt(digitalPinToInterrupt(rxPin), DaliBus_wrapper_pinchangeISR, CHANGE);
+  if (index == instanceCount) {
+    instances[index] = this;
+    instanceCount = index + 1;
+  }
+  attachInterrupt(digitalPinToInterrupt(rxPin), DaliBus_wrapper_pinchangeISR[index], CHANGE);
+
+  // the timer is shared by all buses, start it with the first one
+  if (instanceCount > 1) {
+    timerWake();
+    return true;
+  }
 
   #ifdef DALI_TIMER
   #if defined(ARDUINO_ARCH_RP2040)
   timer2.attachInterrupt(2398, [](repeating_timer *t) -> bool {
-    DaliBus.timerISR();
-    return true;
+    DaliBusClass::timerISRAll();
+    return !timerSleeping; // stopping the repeating timer from within its callback is done by returning false
   });
   #elif defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
   timer2.attachInterrupt(2398, +[](void * timer) -> bool {
-    DaliBus.timerISR();
+    DaliBusClass::timerISRAll();
     return true;
   });
   #elif defined(ARDUINO_ARCH_AVR)
     timer2.init();
     timer2.attachInterrupt(2398, +[](unsigned int outputPin) {
-      DaliBus.timerISR();
+      DaliBusClass::timerISRAll();
     });
-  #elif defined(ARDUINO_ARCH_STM32)
+  #elif defined(ARDUINO_ARCH_STM32) || defined(DALI_HOST)
   timer2.attachInterrupt(2398, []() {
-    DaliBus.timerISR();
+    DaliBusClass::timerISRAll();
   });
   #endif
   #endif
+  return true;
+}
+
+daliReturnValue DaliBusClass::sendRaw(const byte * message, uint8_t bits, daliFrameHandle * handle) {
+  if (txQueueFree() == 0) return DALI_BUSY;
+
+  // fill next free slot, it's handed over to the ISR by advancing txQueueHead
+  uint8_t head = txQueueHead;
+  daliReturnValue result = txFill(head, message, bits, 0);
+  if (result != DALI_SENT) return result;
+  if (handle != nullptr)
+    *handle = head;
+
+  txQueueHead = head + 1;
+  timerWake();
+  return DALI_SENT;
 }
 
-daliReturnValue DaliBusClass::sendRaw(const byte * message, uint8_t bits) {
-  if(bits > 25) return DALI_INVALID_PARAMETER;
-  if(bits != 25 && bits % 8 != 0) return DALI_INVALID_PARAMETER;
-  uint8_t length = (bits - (bits % 8)) / 8;
-  if(bits % 8 != 0) length++;
-  if (busState != IDLE) return DALI_BUSY;
+daliReturnValue DaliBusClass::sendSequence(const daliFrame * frames, uint8_t count, daliFrameHandle * handle,
+                                           bool reuse_dtr, int16_t dtr_epoch) {
+  if (count == 0 || count > DALI_SEQUENCE_SIZE) return DALI_INVALID_PARAMETER;
+  for (uint8_t i = 0; i < count; i++)
+    if (!isValidLength(frames[i].bits)) return DALI_INVALID_PARAMETER;
+  if (txQueueFree() < count) return DALI_BUSY;
 
-  // prepare variables for sending
-  for (byte i = 0; i < length; i++)
-    txMessage[i] = message[i];
+  // fill all slots before handing them over at once, so the ISR never sees part of the sequence
+  uint8_t head = txQueueHead;
+  uint8_t queued = 0;
+  bool reused = dtr_epoch >= 0;
+  uint8_t reusedEpoch = dtr_epoch;
+  for (uint8_t i = 0; i < count; i++) {
+    int8_t reg = dtrWritten(frames[i].data, frames[i].bits);
+    if (reuse_dtr && reg >= 0 && i < count - 1 && dtrHolds(reg, frames[i].data[1])) {
+      if (!reused)
+        reusedEpoch = dtrValidEpoch;
+      reused = true;
+      continue;
+    }
+    txFill(head + queued, frames[i].data, frames[i].bits, (queued > 0 ? TX_SEQUENCE_PREV : 0) | TX_SEQUENCE_NEXT);
+    queued++;
+  }
+  txQueue[(head + queued - 1) & (DALI_TX_QUEUE_SIZE - 1)].flags &= ~TX_SEQUENCE_NEXT;
+  if (reused) { // checked by the ISR before sending the first frame
+    txFrame &first = txQueue[head & (DALI_TX_QUEUE_SIZE - 1)];
+    first.flags |= TX_DTR_REUSED;
+    first.dtrEpoch = reusedEpoch;
+  }
+  if (handle != nullptr)
+    *handle = head + queued - 1;
 
-  if(bits == 25) {
-    txMessage[3] = (txMessage[2] & 1) << 7;
-    txMessage[2] = (txMessage[2] >> 1) | 0b10000000;
+  txQueueHead = head + queued;
+  timerWake();
+  return DALI_SENT;
+}
+
+bool DaliBusClass::dtrHolds(uint8_t reg, uint8_t value) const {
+  return reg < 3 && dtrValidEpoch == dtrEpoch && ((dtrValid >> reg) & 1) && dtrValues[reg] == value;
+}
+
+// DTR set by a frame: 0-2 for SET_DTR, SET_DTR1 and SET_DTR2, -2 for frames that make the control gear change DTRs
+// on its own, otherwise -1
+int8_t DaliBusClass::dtrWritten(const byte * message, uint8_t bits) {
+  if (bits != 16) return -1;
+  switch (message[0]) {
+    case 0xA3: return 0;
+    case 0xC3: return 1;
+    case 0xC5: return 2;
+    case 0xC7: case 0xC9: return -2; // WRITE MEMORY LOCATION increments DTR0
   }
+  bool command = (message[0] & 1) && (message[0] < 0xA0 || message[0] >= 0xFC);
+  // STORE ACTUAL LEVEL IN DTR0, READ MEMORY LOCATION, QUERY COLOUR VALUE (DT8)
+  if (command && (message[1] == 33 || message[1] == 197 || message[1] == 250)) return -2;
+  return -1;
+}
 
-  txLength = bits;
-  txCollision = 0;
-  rxMessage = DALI_RX_EMPTY;
-  rxLength = 0;
+// DaliCommandFlags of a frame queued next. Commands the control gear may answer to, and frames this library doesn't
+// know, get DALI_CMD_ANSWER.
+uint8_t DaliBusClass::commandFlags(const byte * message, uint8_t bits) const {
+  if (bits != 16) return DALI_CMD_ANSWER;
+  byte address = message[0];
+  if (address < 0xA0 || address >= 0xFC) { // short, group or broadcast address
+    if (!(address & 1)) return 0; // direct arc power
+    if (message[1] >= 224) // application extended commands depend on the enabled device type
+      return txEnabledType == 8 ? daliDT8CmdFlags(message[1]) : DALI_CMD_ANSWER;
+    return daliCmdFlags(message[1]);
+  }
+  if ((address & 1) && address <= 0xCB)
+    return daliSpecialCmdFlags(256 + ((address - 0xA1) >> 1));
+  return DALI_CMD_ANSWER;
+}
+
+// fill slot @p index of the transmit queue, it's not handed over to the ISR yet
+daliReturnValue DaliBusClass::txFill(uint8_t index, const byte * message, uint8_t bits, uint8_t flags) {
+  if (!isValidLength(bits)) return DALI_INVALID_PARAMETER;
+
+  txFrame &frame = txQueue[index & (DALI_TX_QUEUE_SIZE - 1)];
+  for (byte i = 0; i < 3; i++)
+    frame.message[i] = i < bits / 8 ? message[i] : 0;
+  frame.bits = bits;
+  txEncode(frame);
+  frame.handle = index;
+  frame.result = DALI_PENDING;
+  frame.callback = nullptr;
+  frame.times[0] = getEdgeTime;
+  frame.stage = 0;
 
-  // initiate transmission
-  busState = TX_START_1ST;
+  // follow the DTRs, see dtrHolds()
+  if (dtrValidEpoch != dtrEpoch) {
+    dtrValid = 0;
+    dtrValidEpoch = dtrEpoch;
+  }
+  int8_t reg = dtrWritten(message, bits);
+  if (reg >= 0) {
+    dtrValues[reg] = message[1];
+    dtrValid |= 1 << reg;
+    flags |= TX_DTR_WRITE;
+  } else if (reg == -2) {
+    dtrValid = 0;
+  }
+  if (!(commandFlags(message, bits) & DALI_CMD_ANSWER))
+    flags |= TX_NO_ANSWER;
+  txEnabledType = (bits == 16 && message[0] == 0xC1) ? message[1] : 0xFF;
+  frame.flags = flags;
+  frame.settle = settlingTicks[(flags & TX_SEQUENCE_PREV) ? DALI_PRIORITY_TRANSACTION : priority];
   return DALI_SENT;
 }
 
+// expand a frame into the bus levels of its half-bits, from the start bit to the first half of the stop bits, so the
+// timer ISR only has to shift them out. 25 bit frames get a 1 inserted after the second byte.
+void DaliBusClass::txEncode(txFrame & frame) {
+  for (byte i = 0; i < sizeof(frame.wave); i++)
+    frame.wave[i] = 0;
+  uint8_t half = 1; // start bit: low, high
+  frame.wave[0] = 0x40;
+  for (uint8_t i = 0; i < frame.bits; i++) {
+    bool bit;
+    if (frame.bits == 25 && i >= 16)
+      bit = i == 16 || ((frame.message[2] >> (24 - i)) & 1);
+    else
+      bit = (frame.message[i >> 3] >> (7 - (i & 7))) & 1;
+    half += bit ? 2 : 1; // 1: low, high; 0: high, low
+    frame.wave[half >> 3] |= 0x80 >> (half & 7);
+    half += bit ? 0 : 1;
+  }
+  half += 1; // stop bits: high
+  frame.wave[half >> 3] |= 0x80 >> (half & 7);
+}
+
+bool DaliBusClass::supersedeArc(byte address, byte level, daliFrameHandle * handle) {
+  if (level == 0xFF) return false; // MASK keeps the current level, so the earlier level still applies
+  bool updated = false;
+
+  // search back from the newest frame not being transmitted yet, a frame can only be updated if none of the frames
+  // queued after it could be affected by the different order
+  noInterrupts();
+  uint8_t first = txQueueTail + (txActive ? 1 : 0);
+  for (uint8_t index = txQueueHead; index != first; ) {
+    txFrame &frame = txQueue[--index & (DALI_TX_QUEUE_SIZE - 1)];
+    byte frameAddress = frame.message[0];
+    if (frame.bits != 16 || (frame.flags & ~TX_NO_ANSWER) || (frameAddress & 1) || ((frameAddress & 0x80) && (frameAddress & 0xE0) != 0x80 && frameAddress != 0xFE))
+      break; // anything but direct arc power on its own
+    if (frameAddress == address) {
+      if (frame.callback == nullptr && frame.message[1] != 0xFF) {
+        frame.message[1] = level;
+        txEncode(frame);
+        if (handle != nullptr)
+          *handle = frame.handle;
+        updated = true;
+      }
+      break;
+    }
+    if ((frameAddress & 0x80) || (address & 0x80))
+      break; // group and broadcast frames may address the same device
+  }
+  interrupts();
+
+#ifndef DALI_NO_STATS
+  if (updated)
+    stats.framesSuperseded++;
+#endif
+  return updated;
+}
+
+int DaliBusClass::getResult(daliFrameHandle handle) {
+  txFrame &frame = txQueue[handle & (DALI_TX_QUEUE_SIZE - 1)];
+  if (frame.handle != handle) return DALI_INVALID_PARAMETER;
+  uint8_t tail = txQueueTail;
+  if ((uint8_t)(handle - tail) < (uint8_t)(txQueueHead - tail)) return DALI_PENDING;
+  decode(); // response may not be decoded yet
+  return frame.result;
+}
+
+uint8_t DaliBusClass::txQueueFree() {
+  if (txQueueDone != txQueueTail) dispatchCompleted(); // release slots of completed frames
+  return DALI_TX_QUEUE_SIZE - (uint8_t)(txQueueHead - txQueueDone);
+}
+
+bool DaliBusClass::onComplete(daliFrameHandle handle, EventHandlerCompletedFuncPtr callback, void * context) {
+  txFrame &frame = txQueue[handle & (DALI_TX_QUEUE_SIZE - 1)];
+  if (frame.handle != handle) return false;
+  if ((uint8_t)(handle - txQueueDone) >= (uint8_t)(txQueueHead - txQueueDone)) return false; // already dispatched
+  frame.callback = callback;
+  frame.context = context;
+  return true;
+}
+
+// call completion callbacks and release slots of completed frames
+void DaliBusClass::dispatchCompleted() {
+  if (txDispatching) return; // callback queued another frame
+  txDispatching = true;
+  uint8_t tail = txQueueTail;
+  decode(); // set results of all frames up to tail
+  while (txQueueDone != tail) {
+    txFrame &frame = txQueue[txQueueDone & (DALI_TX_QUEUE_SIZE - 1)];
+    EventHandlerCompletedFuncPtr callback = frame.callback;
+    daliFrameHandle handle = frame.handle;
+    int result = frame.result;
+    void * context = frame.context;
+    daliFrame sent;
+    if (monitorCallback != nullptr || trace != nullptr) {
+      sent.timestamp = edgeMicros(frame.times[frame.stage ? DALI_LATENCY_TRANSMIT : DALI_LATENCY_QUEUED]);
+      sent.bits = frame.bits;
+      for (byte i = 0; i < 3; i++)
+        sent.data[i] = frame.message[i];
+      sent.error = DALI_NO_ERROR;
+    }
+    frame.callback = nullptr;
+#ifndef DALI_NO_STATS
+    for (uint8_t stage = 0; stage < frame.stage; stage++)
+      countLatency((daliLatencyStage)stage, frame.times[stage + 1] - frame.times[stage]);
+    if (frame.stage > DALI_LATENCY_TRANSMIT)
+      stats.framesSent++;
+    if (result >= 0)
+      stats.responses++;
+#endif
+    txQueueDone++;
+    if (trace != nullptr) {
+      if (frame.stage > DALI_LATENCY_QUEUED) // not for the rest of an aborted sequence
+        trace->record(DALI_TRACE_SENT, sent.timestamp, sent.bits, sent.data);
+      if (result >= 0) {
+        uint8_t response[3] = { (uint8_t)result, 0, 0 };
+        trace->record(DALI_TRACE_RESPONSE, edgeMicros(frame.times[DALI_LATENCY_STAGES]), 8, response);
+      } else if (result != DALI_RX_EMPTY) {
+        uint8_t error[3] = { (uint8_t)-result, 1, 0 };
+        trace->record(DALI_TRACE_ERROR, sent.timestamp, 0, error);
+      }
+    }
+    if (monitorCallback != nullptr)
+      monitorCallback(sent, result, monitorContext);
+    if (callback != nullptr)
+      callback(handle, result, context);
+  }
+  txDispatching = false;
+}
+
+#ifndef DALI_NO_STATS
+void DaliBusClass::countLatency(daliLatencyStage stage, uint32_t ticks) {
+  uint32_t ms = ticks / ticksPerUs / 1000;
+  uint8_t bin = 0;
+  while (ms != 0 && bin < DALI_LATENCY_BINS - 1) {
+    ms >>= 1;
+    bin++;
+  }
+  stats.latency[stage][bin]++;
+}
+
+void DaliBusClass::getStats(daliBusStats & snapshot, bool reset) {
+  noInterrupts();
+  uint32_t busy = busyTicks;
+  uint64_t isrSum = isrTicks;
+  uint32_t isrMax = isrTicksMax;
+  for (uint8_t i = 0; i < DALI_STATS_ERRORS; i++)
+    snapshot.errors[i] = stats.errors[i];
+  snapshot.isrCount = stats.isrCount;
+  interrupts();
+
+  snapshot.period = millis() - statsStart;
+  snapshot.framesSent = stats.framesSent;
+  snapshot.framesReceived = stats.framesReceived;
+  snapshot.responses = stats.responses;
+  snapshot.framesSuperseded = stats.framesSuperseded;
+  snapshot.collisionRetries = stats.collisionRetries;
+  memcpy(snapshot.latency, stats.latency, sizeof(stats.latency));
+  // the timer ticks 2.398 times per ms
+  uint32_t utilization = snapshot.period ? (uint64_t)busy * 100000 / ((uint64_t)snapshot.period * 2398) : 0;
+  snapshot.utilization = (utilization > 100) ? 100 : utilization;
+  snapshot.isrTimeAvg = snapshot.isrCount ? isrSum * 1000 / ticksPerUs / snapshot.isrCount : 0;
+  snapshot.isrTimeMax = (uint64_t)isrMax * 1000 / ticksPerUs;
+
+  if (reset) resetStats();
+}
+
+void DaliBusClass::resetStats() {
+  noInterrupts();
+  memset(&stats, 0, sizeof(stats));
+  busyTicks = 0;
+  isrTicks = 0;
+  isrTicksMax = 0;
+  interrupts();
+  statsStart = millis();
+}
+#endif
+
 bool DaliBusClass::busIsIdle() {
-  return (busState == IDLE);
+  return (busState == IDLE && txQueueTail == txQueueHead);
+}
+
+unsigned long DaliBusClass::idleTime() {
+  noInterrupts();
+  uint32_t lastEdge = rxLastEdge;
+  interrupts();
+  return (uint32_t)(getEdgeTime - lastEdge) / ticksPerUs;
 }
 
+// response to the last completed frame, reported only once
 int DaliBusClass::getLastResponse() {
+  daliFrameHandle last = txQueueTail - 1;
+  txFrame &frame = txQueue[last & (DALI_TX_QUEUE_SIZE - 1)];
+  if (frame.handle != last || last == lastResponseHandle) return DALI_RX_EMPTY;
+  decode();
+  lastResponseHandle = last;
+  int response = frame.result;
+  return (response >= 0 || response == DALI_RX_ERROR) ? response : DALI_RX_EMPTY;
+}
+
+bool DaliBusClass::receive(daliFrame & frame) {
+  decode();
+  uint8_t tail = rxQueueTail;
+  if (tail == rxQueueHead) return false;
+
+  frame = rxQueue[tail & (DALI_RX_QUEUE_SIZE - 1)];
+  rxQueueTail = tail + 1;
+  if (monitorCallback != nullptr)
+    monitorCallback(frame, DALI_PENDING, monitorContext);
+  return true;
+}
+
+uint8_t DaliBusClass::available() {
+  decode();
+  return rxQueueHead - rxQueueTail;
+}
+
+void DaliBusClass::loop() {
+  dispatchCompleted();
+  if (receivedCallback == 0 && monitorCallback == nullptr && events == nullptr) return;
+
+  daliFrame frame;
+  while (receive(frame)) {
+    if (frame.error != DALI_NO_ERROR) continue;
+    if (events != nullptr && frame.bits == 24)
+      events->handle(frame);
+    if (receivedCallback != 0)
+      receivedCallback(frame.data, frame.bits);
+  }
+}
+
+int DaliTransaction::result() const {
+  if (bus == nullptr) return error;
+  return bus->getResult(handle);
+}
+
+int DaliTransaction::wait(byte timeout) const {
+  unsigned long time = millis();
   int response;
-  switch (rxLength) {
-    case 16:
-      response = rxMessage;
-      break;
-    case 0:
-      response = DALI_RX_EMPTY;
+  while ((response = result()) == DALI_PENDING)
+    if (millis() - time > timeout) return DALI_SEND_TIMEOUT;
+  return response;
+}
+
+void DaliTransaction::then(EventHandlerCompletedFuncPtr callback, void * context) const {
+  if (bus == nullptr || !bus->onComplete(handle, callback, context))
+    callback(handle, result(), context);
+}
+
+// duration classes of a level run between two edges
+enum { RUN_SHORT, RUN_TE, RUN_BETWEEN, RUN_2TE, RUN_LONG };
+static const int8_t RUN_EMIT = 2;
+
+// Manchester decoder actions by phase (0: at a bit boundary, 1: in the middle of a bit) and duration class of a level
+// run: the next phase, plus RUN_EMIT if the run completes a bit of its level, or the error
+static const int8_t decodeTable[2][5] = {
+  { DALI_ERROR_TIMING, 1,            DALI_ERROR_TIMING, DALI_ERROR_MANCHESTER, DALI_ERROR_TIMING },
+  { DALI_ERROR_TIMING, 0 | RUN_EMIT, DALI_ERROR_TIMING, 1 | RUN_EMIT,          DALI_ERROR_TIMING },
+};
+
+// decode the frame recorded in rxEdges from start to end, called from the main loop only
+void DaliBusClass::decodeFrame(uint8_t start, uint8_t end, daliFrame & frame) {
+  // lower limits of the duration classes RUN_TE to RUN_LONG in ticks
+  const uint32_t limits[4] = {
+    (uint32_t)(DALI_TE_MIN * ticksPerUs), (uint32_t)((DALI_TE_MAX + 1) * ticksPerUs),
+    (uint32_t)(2 * DALI_TE_MIN * ticksPerUs), (uint32_t)((2 * DALI_TE_MAX + 1) * ticksPerUs)
+  };
+  uint32_t edge = rxEdges[start & (DALI_EDGE_QUEUE_SIZE - 1)];
+  frame.timestamp = edgeMicros(edge);
+
+  uint32_t data = 0;
+  int8_t bits = -1; // start bit is the first bit completed
+  uint8_t phase = 0;
+  daliReturnValue error = (start == end) ? DALI_ERROR_TIMING : DALI_NO_ERROR;
+  for (uint8_t i = start + 1; error == DALI_NO_ERROR; i++) {
+    byte level = edge & 1;
+    if (i == end) { // the bus stays high for the stop bits, completing a bit started low
+      if (level != HIGH)
+        error = DALI_ERROR_TIMING;
+      else if (phase == 1) {
+        data = data << 1 | 1;
+        bits++;
+      }
       break;
-    default:
-      response = DALI_RX_ERROR;
+    }
+
+    uint32_t next = rxEdges[i & (DALI_EDGE_QUEUE_SIZE - 1)];
+    uint32_t duration = (next & ~(uint32_t)1) - (edge & ~(uint32_t)1);
+    uint8_t run = RUN_SHORT;
+    while (run < RUN_LONG && duration >= limits[run])
+      run++;
+    int8_t action = decodeTable[phase][run];
+    if ((next & 1) == level) // missed an edge in between
+      error = DALI_ERROR_TIMING;
+    else if (i == (uint8_t)(start + 1) && run != RUN_TE)
+      error = DALI_INVALID_STARTBIT;
+    else if (action < 0)
+      error = (daliReturnValue)action;
+    else {
+      if (action & RUN_EMIT) {
+        data = data << 1 | level;
+        bits++;
+      }
+      phase = action & 1;
+    }
+    edge = next;
+  }
+
+  if (bits < 0) bits = 0;
+  if (error == DALI_NO_ERROR && bits != 8 && bits != 16 && bits != 24 && bits != 25)
+    error = DALI_ERROR_LENGTH;
+  if (bits == 25) // remove fixed 1 in front of last byte
+    data = ((data >> 9) << 8) | (data & 0xFF);
+  uint8_t length = (bits >= 24) ? 3 : (bits + 7) >> 3;
+  frame.bits = bits;
+  for (byte i = 0; i < 3; i++)
+    frame.data[i] = (i < length) ? (data >> (8 * (length - 1 - i))) & 0xFF : 0;
+  frame.error = error;
+}
+
+// decode frames recorded by the ISRs, store responses as result of their frame and other frames in the rx queue,
+// called from the main loop only
+void DaliBusClass::decode() {
+  while (rxMarkTail != rxMarkHead) {
+    volatile rxMark &mark = rxMarks[rxMarkTail & (DALI_RX_QUEUE_SIZE - 1)];
+    daliFrame frame;
+    decodeFrame(mark.edgeStart, mark.edgeEnd, frame);
+    if (mark.overrun)
+      frame.error = DALI_ERROR_OVERRUN;
+    rxEdgeTail = mark.edgeEnd;
+#ifndef DALI_NO_STATS
+    if (!mark.response && frame.error == DALI_NO_ERROR)
+      stats.framesReceived++;
+#endif
+
+    if (!mark.response && trace != nullptr) {
+      if (frame.error == DALI_NO_ERROR)
+        trace->record(DALI_TRACE_RECEIVED, frame.timestamp, frame.bits, frame.data);
+      else {
+        uint8_t error[3] = { (uint8_t)-frame.error, 0, frame.bits };
+        trace->record(DALI_TRACE_ERROR, frame.timestamp, 0, error);
+      }
+    }
+
+    if (mark.foreign && frame.error == DALI_NO_ERROR) {
+      int8_t reg = dtrWritten(frame.data, frame.bits);
+      if (reg == -1 || reg == 0) // leaves DTR1 and DTR2 alone, see dtrChanges(uint8_t)
+        dtrKept++;
+    }
+
+    if (mark.response)
+      txQueue[mark.handle & (DALI_TX_QUEUE_SIZE - 1)].result =
+        (frame.error == DALI_NO_ERROR && frame.bits == 8) ? frame.data[0] : DALI_RX_ERROR;
+    else if ((uint8_t)(rxQueueHead - rxQueueTail) < DALI_RX_QUEUE_SIZE) { // drop frame if queue is full
+      rxQueue[rxQueueHead & (DALI_RX_QUEUE_SIZE - 1)] = frame;
+      rxQueueHead++;
+    }
+    rxMarkTail = rxMarkTail + 1;
+
+    if (frame.error != DALI_NO_ERROR) {
+      countError(frame.error);
+      if (errorCallback != 0)
+        errorCallback(frame.error);
+    }
+  }
+}
+
+// load frame at txQueueTail for transmission, called from timerISR only
+void DaliBusClass::txStartNext() {
+  txFrame &frame = txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)];
+  txWave = frame.wave;
+  txWaveBits = frame.wave[0];
+  txHalf = 0;
+  txHalves = 2 * frame.bits + 3;
+  txCollision = 0;
+  txActive = true;
+  txSequence = false;
+  frame.times[DALI_LATENCY_TRANSMIT] = getEdgeTime;
+  frame.stage = DALI_LATENCY_TRANSMIT;
+}
+
+// store result of current frame and release it, called from ISRs only
+void DaliBusClass::txComplete(int result) {
+  if (!txActive) return;
+  txFrame &frame = txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)];
+  frame.result = result;
+  txActive = false;
+  txQueueTail = txQueueTail + 1;
+  txCollisions = 0;
+  txBackoff = txRandomTicks() % 3;
+  bool failed = result == DALI_COLLISION || result == DALI_PULLDOWN || result == DALI_CANT_BE_HIGH;
+  if (failed && (frame.flags & TX_DTR_WRITE))
+    dtrEpoch = dtrEpoch + 1;
+  if (frame.flags & TX_SEQUENCE_NEXT) {
+    txSequence = true;
+    if (failed)
+      txAbortSequence(result);
+  }
+}
+
+// complete the rest of the sequence continued by the frame at txQueueTail with @p result, called from ISRs only
+void DaliBusClass::txAbortSequence(int result) {
+  if (!txSequence) return;
+  txSequence = false;
+  uint8_t flags;
+  do { // sequences are queued at once, so all frames are there
+    txFrame &frame = txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)];
+    frame.result = result;
+    flags = frame.flags;
+    if (flags & TX_DTR_WRITE)
+      dtrEpoch = dtrEpoch + 1;
+    txQueueTail = txQueueTail + 1;
+  } while (flags & TX_SEQUENCE_NEXT);
+  txCollisions = 0;
+  txBackoff = txRandomTicks() % 3;
+}
+
+// next value of the xorshift generator used for settling time jitter and backoff
+uint8_t DaliBusClass::txRandomTicks() {
+  txRandom ^= txRandom << 7;
+  txRandom ^= txRandom >> 9;
+  txRandom ^= txRandom << 8;
+  return txRandom;
+}
+
+// frame at txQueueTail collided with a frame of another participant, called from pinchangeISR only
+void DaliBusClass::txCollided() {
+  dtrEpoch = dtrEpoch + 1; // the other frame may change DTRs
+  // frames continuing a sequence can't be sent again, the other frame got in between
+  txFrame &frame = txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)];
+  if (txCollisions >= DALI_COLLISION_RETRIES || (frame.flags & TX_SEQUENCE_PREV)) {
+    txComplete(DALI_COLLISION);
+    return;
+  }
+
+  // send again from IDLE after a random backoff, doubling with each collision, so both don't collide once more
+  txCollisions++;
+  txBackoff = txRandomTicks() & ((2 << (txCollisions < 5 ? txCollisions : 5)) - 1);
+  txActive = false;
+#ifndef DALI_NO_STATS
+  stats.collisionRetries++;
+#endif
+}
+
+// hand the edges of the frame just received over to decode(), called from ISRs only
+void DaliBusClass::rxEnd() {
+  // a backward frame lasts 18 TE, anything longer is a forward frame of another participant
+  bool foreign = !rxIsResponse ||
+    rxLastEdge - rxEdges[rxFrameStart & (DALI_EDGE_QUEUE_SIZE - 1)] >= (uint32_t)(22 * DALI_TE_MAX * ticksPerUs);
+
+  uint8_t head = rxMarkHead;
+  bool marked = (uint8_t)(head - rxMarkTail) < DALI_RX_QUEUE_SIZE; // else the queue is full and the frame is dropped
+  if (marked) {
+    volatile rxMark &mark = rxMarks[head & (DALI_RX_QUEUE_SIZE - 1)];
+    mark.edgeStart = rxFrameStart;
+    mark.edgeEnd = rxEdgeHead;
+    mark.response = rxIsResponse;
+    mark.foreign = foreign;
+    mark.overrun = rxOverrun;
+    mark.handle = txQueueTail;
+    rxMarkHead = head + 1;
+  }
+  if (rxIsResponse) {
+    txFrame &frame = txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)];
+    frame.times[DALI_LATENCY_STAGES] = rxLastEdge;
+    frame.stage = DALI_LATENCY_STAGES;
+    txComplete(marked ? DALI_PENDING : DALI_ERROR_OVERRUN); // decode() sets the result of a marked frame
+  }
+  if (!foreign) return;
+
+  // DTR tracking and the sequence guarantee hold even if the frame itself is dropped
+  dtrEpoch = dtrEpoch + 1; // the frame may have changed the DTRs
+  if (txSequence) { // another participant got in between
+    countError(DALI_COLLISION);
+    txAbortSequence(DALI_COLLISION);
   }
-  rxLength = 0;
-  return response;
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+void __time_critical_func(DaliBusClass::timerISRAll()) {
+#elif defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+void IRAM_ATTR DaliBusClass::timerISRAll() {
+#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32) || defined(DALI_HOST)
+void DaliBusClass::timerISRAll() {
+#endif
+  for (uint8_t i = 0; i < instanceCount; i++)
+    instances[i]->timerISR();
+
+  #if defined(DALI_TIMER) && !defined(DALI_NO_TICKLESS)
+  // stop ticking until the next edge or transmit request (see timerWake()) once all buses have settled with
+  // nothing to do, the bus is high then as it would have been detected as shorted otherwise
+  for (uint8_t i = 0; i < instanceCount; i++) {
+    if (!instances[i]->busIsSettled(DALI_PRIORITY_POLL)) return;
+  }
+  timerSleeping = true;
+  #ifndef ARDUINO_ARCH_RP2040
+  timer2.stopTimer();
+  #endif
+  #endif
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+void __time_critical_func(DaliBusClass::timerWake()) {
+#elif defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+void IRAM_ATTR DaliBusClass::timerWake() {
+#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32) || defined(DALI_HOST)
+void DaliBusClass::timerWake() {
+#endif
+  #if defined(DALI_TIMER) && !defined(DALI_NO_TICKLESS)
+  if (!timerSleeping) return;
+  timerSleeping = false;
+  timer2.restartTimer();
+  #endif
 }
 
 #if defined(ARDUINO_ARCH_RP2040)
 void __time_critical_func(DaliBusClass::timerISR()) {
 #elif defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
 void IRAM_ATTR DaliBusClass::timerISR() {
-#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32)
+#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32) || defined(DALI_HOST)
 void DaliBusClass::timerISR() {
+#endif
+#ifndef DALI_NO_STATS
+  uint32_t start = getEdgeTime;
+  timerTick();
+  isrDone(start);
+  if (busState != IDLE && busState != SHORT)
+    busyTicks++;
+#else
+  timerTick();
+#endif
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+void __time_critical_func(DaliBusClass::timerTick()) {
+#elif defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+void IRAM_ATTR DaliBusClass::timerTick() {
+#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32) || defined(DALI_HOST)
+void DaliBusClass::timerTick() {
 #endif
   if (busIdleCount < 0xff) // increment idle counter avoiding overflow
     busIdleCount++;
 
-  if (busIdleCount == 4 && getBusLevel == LOW) { // bus is low idle for more than 2 TE, something's pulling down for too long
+  if (busIdleCount == 4 && getBusLevel == LOW && busState == RX && rxIsResponse) {
+    // backward frames of several control gear overlapping, the bits that differ add up to a long low level. It's an
+    // answer nonetheless, like any other garbled one.
+    txComplete(DALI_RX_ERROR);
+    dtrEpoch = dtrEpoch + 1; // or another master's frame got in
+    countError(DALI_ERROR_TIMING);
+    busState = SHORT; // until the bus is released
+    if(errorCallback != 0)
+      errorCallback(DALI_ERROR_TIMING);
+  } else if (busIdleCount == 4 && getBusLevel == LOW) { // bus is low idle for more than 2 TE, something's pulling down for too long
+    txComplete(DALI_PULLDOWN);
+    txAbortSequence(DALI_PULLDOWN);
+    dtrEpoch = dtrEpoch + 1; // control gear may have lost power
+    countError(DALI_PULLDOWN);
     busState = SHORT;
     setBusLevel(HIGH);
     if(errorCallback != 0)
@@ -148,92 +839,55 @@ void DaliBusClass::timerISR() {
 
   // timer state machine
   switch (busState) {
-    case TX_START_1ST: // initiate transmission by setting bus low (1st half)
-      if (busIdleCount >= 26) { // wait at least 9.17ms (22 TE) settling time before sending (little more for TCI compatibility)
-        setBusLevel(LOW);
-        busState = TX_START_2ND;
-      }
-      break;
-    case TX_START_2ND: // send start bit (2nd half)
-      setBusLevel(HIGH);
-      txPos = 0;
-      busState = TX_BIT_1ST;
-      break;
-    case TX_BIT_1ST: // prepare bus for bit (1st half)
-      if (txMessage[txPos >> 3] & 1 << (7 - (txPos & 0x7)))
-      {
-        setBusLevel(LOW);
-      } else {
-        setBusLevel(HIGH);
-      }
-      busState = TX_BIT_2ND;
-      break;
-    case TX_BIT_2ND: // send bit (2nd half)
-      if (txMessage[txPos >> 3] & 1 << (7 - (txPos & 0x7)))
-      {
-        setBusLevel(HIGH);
-      } else {
-        setBusLevel(LOW);
+    case IDLE: // pick up next queued frame
+      if (txQueueTail == txQueueHead ||
+          busIdleCount < txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)].settle + txBackoff) // settling time by priority
+        break;
+      if ((txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)].flags & TX_DTR_REUSED) &&
+          txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)].dtrEpoch != dtrEpoch) {
+        txSequence = true; // DTRs the sequence relies on may have changed, drop it
+        txAbortSequence(DALI_COLLISION);
+        break;
       }
-      txPos++;
-      if (txPos < txLength)
-        busState = TX_BIT_1ST;
-      else
-        busState = TX_STOP_1ST;
-      break;
-    case TX_STOP_1ST: // 1st stop bit (1st half)
-      setBusLevel(HIGH);
-      busState = TX_STOP;
+      txStartNext();
+      busState = TX_WAVE;
+      // fall through
+    case TX_WAVE: { // shift out the next half-bit, starting with the start bit
+      byte level = (txWaveBits & 0x80) ? HIGH : LOW;
+      setBusLevel(level);
+      txWaveBits <<= 1;
+      txHalf++;
+      if ((txHalf & 7) == 0)
+        txWaveBits = txWave[txHalf >> 3];
+      if (txHalf == txHalves)
+        busState = TX_STOP;
       break;
+    }
     case TX_STOP: // remaining stop half-bits
       if (busIdleCount >= 4) {
-        busState = WAIT_RX;
-        busIdleCount = 0;
-      }   
+        txFrame &frame = txQueue[txQueueTail & (DALI_TX_QUEUE_SIZE - 1)];
+        frame.times[DALI_LATENCY_RESPONSE] = getEdgeTime;
+        frame.stage = DALI_LATENCY_RESPONSE;
+        if (frame.flags & TX_NO_ANSWER) {
+          txComplete(DALI_RX_EMPTY);
+          busState = IDLE; // nothing to wait for, the settling time before the next frame runs from the last edge
+        } else {
+          busState = WAIT_RX;
+        }
+      }
       break;
-    case WAIT_RX: // wait 9.17ms (22 TE) for a response
-      if (busIdleCount > 22)
+    case WAIT_RX: // wait 9.17ms (22 TE) after the stop bits for a response
+      if (busIdleCount > 4 + 22) {
+        txComplete(DALI_RX_EMPTY);
         busState = IDLE; // response timed out
+      }
       break;
-    case RX_STOP:
+    case RX: // frame incl. stop bits finished, it's decoded outside of interrupt context
       if (busIdleCount > 4) {
-        // rx message incl stop bits finished. 
+        rxEnd();
         busState = IDLE;
       }
       break;
-    case RX_START:
-    case RX_BIT:
-      if (busIdleCount > 3) // bus has been inactive for too long
-      {
-        busState = IDLE;    // rx has been interrupted, bus is idle
-        if(rxLength > 16)
-        {
-          if(receivedCallback != 0)
-          {
-            uint8_t bitlen = (rxLength - (rxLength % 2)) / 2;
-            uint8_t *data = new uint8_t[3];
-            if(bitlen == 25) {
-              uint8_t temp = rxCommand & 0xFF;
-              rxCommand = (rxCommand >> 1) & 0xFFFF;
-              rxCommand |= temp;
-            }
-            uint8_t offset = bitlen - 8;
-            data[0] = (rxCommand >> offset) & 0xFF;
-            offset -= 8;
-            if(offset != 0) {
-              data[1] = (rxCommand >> offset) & 0xFF;
-              offset -= 8;
-            }
-            if(offset != 0) {
-              data[2] = (rxCommand >> offset) & 0xFF;
-              offset -= 8;
-            }
-            receivedCallback(data, bitlen);
-            delete[] data;
-          }
-        }
-      }
-      break;
   }
 }
 
@@ -243,9 +897,23 @@ void __not_in_flash_func(DaliBusClass::pinchangeISR)() {
 void IRAM_ATTR DaliBusClass::pinchangeISR() {
 #else
 void DaliBusClass::pinchangeISR() {
+#endif
+  uint32_t time = getEdgeTime;
+  edgeISR(time);
+  isrDone(time);
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+void __not_in_flash_func(DaliBusClass::edgeISR)(uint32_t time) {
+#elif defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+void IRAM_ATTR DaliBusClass::edgeISR(uint32_t time) {
+#else
+void DaliBusClass::edgeISR(uint32_t time) {
 #endif
   byte busLevel = getBusLevel; // TODO: do we have to check if level actually changed?
   busIdleCount = 0;           // reset idle counter so timer knows that something's happening
+  rxLastEdge = time;
+  timerWake();
 
   if(busLevel != 0 && activityCallback != 0)
     activityCallback();
@@ -254,10 +922,13 @@ void DaliBusClass::pinchangeISR() {
 #ifndef DALI_NO_COLLISSION_CHECK
     if (busLevel != txBusLevel) { // check for collision
       txCollision = 1;	           // signal collision
+      txCollided();
+      countError(DALI_COLLISION);
       if(errorCallback != 0)
         errorCallback(DALI_COLLISION);
       #ifdef DALI_TIMER
-      timer2.restartTimer();
+      if (instanceCount == 1) // timer is shared with other buses otherwise
+        timer2.restartTimer();
       #endif
       busState = IDLE;	               // stop transmission
     }
@@ -265,78 +936,50 @@ void DaliBusClass::pinchangeISR() {
     return;                        // no collision, ignore pin change
   }
 
-  // logical bus level changed -> store timings
-  unsigned long tmp_ts = micros();
-  unsigned long delta = tmp_ts - rxLastChange; // store delta since last change
-  rxLastChange = tmp_ts;                       // store timestamp
-
-  // rx state machine
+  // rx state machine, only frame boundaries are tracked here
   switch (busState) {
     case WAIT_RX:
-      if (busLevel == LOW) { // start of rx frame
-        //Timer1.restart();    // sync timer
-        #ifdef DALI_TIMER
-        timer2.restartTimer();
-        #endif
-        busState = RX_START;
-        rxIsResponse = true;
-      } else {
+      if (busLevel == HIGH) {
+        txComplete(DALI_CANT_BE_HIGH);
+        countError(DALI_CANT_BE_HIGH);
         busState = IDLE; // bus can't actually be high, reset
         if(errorCallback != 0)
           errorCallback(DALI_CANT_BE_HIGH);
+        return;
       }
+      #ifdef DALI_TIMER
+      if (instanceCount == 1) // sync timer
+        timer2.restartTimer();
+      #endif
+      rxIsResponse = true;  // start of rx frame
+      rxFrameStart = rxEdgeHead;
+      rxOverrun = false;
+      busState = RX;
       break;
-    case RX_START:
-      if (busLevel == HIGH && isDeltaWithinTE(delta)) { // validate start bit
-        rxLength = 0; // clear old rx message
-        rxMessage = 0;
-        busState = RX_BIT;
-      } else {                                   // invalid start bit -> reset bus state
-        tempBusLevel = busLevel;
-        tempDelta = delta;
-        rxLength = DALI_RX_ERROR;
-        busState = RX_STOP;
-        if(errorCallback != 0)
-          errorCallback(DALI_INVALID_STARTBIT);
-      }
-      break;
-    case RX_BIT:
-      if (isDeltaWithinTE(delta)) {              // check if change is within time of a half-bit
-        if (rxLength % 2)                        // if rxLength is odd (= actual bit change)
-        {
-          if(rxIsResponse)
-            rxMessage = rxMessage << 1 | busLevel;   // shift in received bit
-          else
-            rxCommand = rxCommand << 1 | busLevel;
-        }
-        rxLength++;
-      } else if (isDeltaWithin2TE(delta)) {       // check if change is within time of two half-bits
-        if(rxIsResponse)
-          rxMessage = rxMessage << 1 | busLevel;   // shift in received bit
-        else
-          rxCommand = rxCommand << 1 | busLevel;
-        rxLength += 2;
-      } else {
-        rxLength = DALI_RX_ERROR;
-        busState = RX_STOP; // timing error -> reset state
-        tempDelta = delta;
-        if(errorCallback != 0)
-          errorCallback(DALI_ERROR_TIMING);
-      }
-      if (rxIsResponse && rxLength == 16) // check if all 8 bits have been received
-        busState = RX_STOP;
+    case IDLE:
+      if (busLevel == HIGH) return; // ignore, we didn't expect rx
+      rxIsResponse = false;
+      rxFrameStart = rxEdgeHead;
+      rxOverrun = false;
+      busState = RX;
       break;
     case SHORT:
       if (busLevel == HIGH)
         busState = IDLE; // recover from bus error
+      return;
+    case RX:
       break;
-    case IDLE:
-      if(busLevel == LOW) {
-        busState = RX_START;
-        rxIsResponse = false;
-      }
-      break;  // ignore, we didn't expect rx
+    default:
+      return;
   }
+
+  // record edge, decoded from the main loop by decode()
+  uint8_t head = rxEdgeHead;
+  if ((uint8_t)(head - rxEdgeTail) < DALI_EDGE_QUEUE_SIZE) {
+    rxEdges[head & (DALI_EDGE_QUEUE_SIZE - 1)] = (time & ~(uint32_t)1) | busLevel;
+    rxEdgeHead = head + 1;
+  } else
+    rxOverrun = true;
 }
 
 DaliBusClass DaliBus;
\ No newline at end of file
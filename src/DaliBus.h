@@ -31,6 +31,10 @@
 
 #include "TimerInterrupt_Generic.h"
 
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+  #include <coroutine>
+#endif
+
 #ifndef DALI_NO_TIMER
   #ifndef DALI_TIMER
     #warning DALI_TIMER not set; default will be set (0)
@@ -50,7 +54,53 @@
   #endif
   #endif
 #else
-  #warning DALI_TIMER not set; make sure to call DaliBusClass::timerISR
+  #warning DALI_TIMER not set; make sure to call DaliBusClass::timerISR (or timerISRAll for multiple buses)
+#endif
+
+#ifndef DALI_MAX_BUSES
+  #define DALI_MAX_BUSES 1
+#endif
+#if DALI_MAX_BUSES < 1 || DALI_MAX_BUSES > 4
+  #error DALI_MAX_BUSES has invalid value (valid values: 1-4)
+#endif
+
+#ifndef DALI_TX_QUEUE_SIZE
+  #define DALI_TX_QUEUE_SIZE 8
+#endif
+#if DALI_TX_QUEUE_SIZE < 2 || DALI_TX_QUEUE_SIZE > 128 || (DALI_TX_QUEUE_SIZE & (DALI_TX_QUEUE_SIZE - 1))
+  #error DALI_TX_QUEUE_SIZE has invalid value (valid values: power of two from 2 to 128)
+#endif
+#ifndef DALI_SEQUENCE_SIZE
+  #if DALI_TX_QUEUE_SIZE < 8
+    #define DALI_SEQUENCE_SIZE DALI_TX_QUEUE_SIZE
+  #else
+    #define DALI_SEQUENCE_SIZE 8
+  #endif
+#endif
+#if DALI_SEQUENCE_SIZE < 2 || DALI_SEQUENCE_SIZE > DALI_TX_QUEUE_SIZE
+  #error DALI_SEQUENCE_SIZE has invalid value (valid values: 2 to DALI_TX_QUEUE_SIZE)
+#endif
+#ifndef DALI_COLLISION_RETRIES
+  #define DALI_COLLISION_RETRIES 3
+#endif
+#if DALI_COLLISION_RETRIES < 0 || DALI_COLLISION_RETRIES > 7
+  #error DALI_COLLISION_RETRIES has invalid value (valid values: 0-7)
+#endif
+#ifndef DALI_RX_QUEUE_SIZE
+  #define DALI_RX_QUEUE_SIZE 8
+#endif
+#if DALI_RX_QUEUE_SIZE < 2 || DALI_RX_QUEUE_SIZE > 128 || (DALI_RX_QUEUE_SIZE & (DALI_RX_QUEUE_SIZE - 1))
+  #error DALI_RX_QUEUE_SIZE has invalid value (valid values: power of two from 2 to 128)
+#endif
+#ifndef DALI_EDGE_QUEUE_SIZE
+  #ifdef ARDUINO_ARCH_AVR
+    #define DALI_EDGE_QUEUE_SIZE 64
+  #else
+    #define DALI_EDGE_QUEUE_SIZE 128
+  #endif
+#endif
+#if DALI_EDGE_QUEUE_SIZE < 64 || DALI_EDGE_QUEUE_SIZE > 128 || (DALI_EDGE_QUEUE_SIZE & (DALI_EDGE_QUEUE_SIZE - 1))
+  #error DALI_EDGE_QUEUE_SIZE has invalid value (valid values: 64 or 128)
 #endif
 
 const int DALI_BAUD = 1200;
@@ -58,15 +108,28 @@ const unsigned long DALI_TE = 417;
 const unsigned long DALI_TE_MIN = ( 80 * DALI_TE) / 100;                 // 333us
 const unsigned long DALI_TE_MAX = (120 * DALI_TE) / 100;                 // 500us
 
-#define isDeltaWithinTE(delta) (DALI_TE_MIN <= delta && delta <= DALI_TE_MAX)
-#define isDeltaWithin2TE(delta) (2*DALI_TE_MIN <= delta && delta <= 2*DALI_TE_MAX)
+// free-running counter for edge timestamps, getEdgeTicksPerUs ticks per µs
+#if defined(ARDUINO_ARCH_RP2040)
+  #define getEdgeTime (timer_hw->timerawl)
+  #define getEdgeTicksPerUs 1
+#elif defined(ARDUINO_ARCH_ESP32)
+  #define getEdgeTime (ESP.getCycleCount())
+  #define getEdgeTicksPerUs getCpuFrequencyMhz()
+#elif defined(ARDUINO_ARCH_ESP8266)
+  #define getEdgeTime (ESP.getCycleCount())
+  #define getEdgeTicksPerUs ESP.getCpuFreqMHz()
+#else
+  #define getEdgeTime micros()
+  #define getEdgeTicksPerUs 1
+#endif
+
 #if defined(ARDUINO_ARCH_RP2040)
   #define getBusLevel (activeLow ? !gpio_get(rxPin) : gpio_get(rxPin))
   #define setBusLevel(level) gpio_put(txPin, (activeLow ? !level : level)); txBusLevel = level;
 #elif defined(ARDUINO_ARCH_ESP32)
-  #define getBusLevel (activeLow ? !(DaliBus.fastRead(rxPin)) : DaliBus.fastRead(rxPin))
-  #define setBusLevel(level) DaliBus.fastWrite(txPin, (activeLow ? !level : level)); txBusLevel = level;
-#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32)
+  #define getBusLevel (activeLow ? !(fastRead(rxPin)) : fastRead(rxPin))
+  #define setBusLevel(level) fastWrite(txPin, (activeLow ? !level : level)); txBusLevel = level;
+#elif defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_STM32) || defined(DALI_HOST)
   #define getBusLevel (activeLow ? !digitalRead(rxPin) : digitalRead(rxPin))
   #define setBusLevel(level) digitalWrite(txPin, (activeLow ? !level : level)); txBusLevel = level;
 #else
@@ -88,19 +151,172 @@ typedef enum daliReturnValue {
   DALI_CANT_BE_HIGH = -10,
   DALI_INVALID_STARTBIT = -11,
   DALI_ERROR_TIMING = -12,
+  DALI_PENDING = -13,
+  DALI_ERROR_MANCHESTER = -14, /**< no transition in the middle of a bit */
+  DALI_ERROR_LENGTH = -15,     /**< frame isn't 8, 16, 24 or 25 bits long */
+  DALI_ERROR_OVERRUN = -16,    /**< edges lost, the edge queue wasn't decoded in time */
+  DALI_ERROR_VERIFY = -17,     /**< memory bank location reads back differently than written, see DaliMemory, or short
+                                    address not verified, see DaliCommissioner */
+  DALI_NO_ADDRESS_FREE = -18,  /**< all short addresses are in use, see DaliCommissioner */
 } daliReturnValue;
 
+/** frame received from the bus, see DaliBusClass::receive() */
+typedef struct daliFrame {
+  unsigned long timestamp; /**< micros() at the start bit */
+  uint8_t bits;            /**< number of bits received (8, 16, 24 or 25 for valid frames) */
+  uint8_t data[3];         /**< payload, first received byte in data[0] */
+  daliReturnValue error;   /**< DALI_NO_ERROR or reception error (DALI_INVALID_STARTBIT, DALI_ERROR_TIMING,
+                                DALI_ERROR_MANCHESTER, DALI_ERROR_LENGTH or DALI_ERROR_OVERRUN) */
+} daliFrame;
+
+/** stages of a transaction timed by daliBusStats::latency */
+enum daliLatencyStage {
+  DALI_LATENCY_QUEUED,   /**< from sendRaw() to the start bit */
+  DALI_LATENCY_TRANSMIT, /**< from the start bit to the end of the stop bits */
+  DALI_LATENCY_RESPONSE, /**< from the end of the stop bits to the last edge of the backward frame */
+  DALI_LATENCY_STAGES
+};
+
+const uint8_t DALI_LATENCY_BINS = 11;  /**< bin n counts latencies below 2^n ms, the last one all longer ones */
+const uint8_t DALI_STATS_ERRORS = 17;  /**< errors are counted in daliBusStats::errors[-code] */
+
+/** priority classes of forward frames (IEC 62386-101), each with its own settling time the bus has to be idle before a
+  * frame is sent, so frames of a higher priority win over those of other masters waiting as well. See
+  * DaliBusClass::priority */
+enum daliPriority {
+  DALI_PRIORITY_TRANSACTION = 1, /**< 13.5-14.7 ms, frames following the first one of a sequence (set automatically) */
+  DALI_PRIORITY_USER = 2,        /**< 14.9-16.2 ms, user instigated commands */
+  DALI_PRIORITY_CONFIG = 3,      /**< 16.3-17.7 ms, configuration */
+  DALI_PRIORITY_AUTOMATIC = 4,   /**< 17.9-19.3 ms, automatic actions */
+  DALI_PRIORITY_POLL = 5         /**< 19.5-21.2 ms, periodic queries */
+};
+
+/** bus statistics, see DaliBusClass::getStats() */
+typedef struct daliBusStats {
+  unsigned long period;     /**< ms since the last reset */
+  uint32_t framesSent;      /**< own frames transmitted completely */
+  uint32_t framesReceived;  /**< frames of other participants received without error */
+  uint32_t responses;       /**< valid backward frames to own frames */
+  uint32_t framesSuperseded; /**< pending direct arc power frames updated instead of queueing another one */
+  uint32_t collisionRetries; /**< frames sent again after a collision */
+  uint32_t errors[DALI_STATS_ERRORS]; /**< count per ::daliReturnValue, index is the negated error code */
+  uint8_t utilization;      /**< % of time the bus has been transmitting, receiving or waiting for a response */
+  uint32_t isrCount;        /**< timer and pin change interrupts handled */
+  uint32_t isrTimeAvg;      /**< average execution time of the interrupt handlers in ns */
+  uint32_t isrTimeMax;      /**< longest execution time of an interrupt handler in ns */
+  uint32_t latency[DALI_LATENCY_STAGES][DALI_LATENCY_BINS]; /**< frames per latency bin, by ::daliLatencyStage */
+} daliBusStats;
+
+/** handle of a queued frame, see DaliBusClass::sendRaw() and DaliBusClass::getResult() */
+typedef uint8_t daliFrameHandle;
+
 typedef void (*EventHandlerReceivedDataFuncPtr)(uint8_t *data, uint8_t bits);
+typedef void (*EventHandlerCompletedFuncPtr)(daliFrameHandle handle, int result, void * context);
+typedef void (*EventHandlerMonitorFuncPtr)(const daliFrame & frame, int response, void * context);
 typedef void (*EventHandlerActivityFuncPtr)();
 typedef void (*EventHandlerErrorFuncPtr)(daliReturnValue errorCode);
 
+class DaliTrace;
+class DaliEvents;
+
 class DaliBusClass {
   public:
-    void begin(byte tx_pin, byte rx_pin, bool active_low = true);
-    daliReturnValue sendRaw(const byte * message, uint8_t bits);
+    /** Start the bus, see DaliClass::begin()
+      * @return false if more than #DALI_MAX_BUSES buses are started
+      *
+      * All buses share a single timer, pin change interrupts are dispatched to the respective bus. */
+    bool begin(byte tx_pin, byte rx_pin, bool active_low = true);
+
+    /** Queue raw frame for transmission
+      * @param message  byte array to send
+      * @param bits     number of bits to send (8, 16, 24 or 25)
+      * @param handle   optional, receives the handle to collect the result with getResult()
+      * @return DALI_SENT if queued, DALI_BUSY if the queue is full or DALI_INVALID_PARAMETER
+      *
+      * Frames are sent back-to-back by timerISR() in the order they were queued. Only a single
+      * context (usually the main loop) may queue frames. */
+    daliReturnValue sendRaw(const byte * message, uint8_t bits, daliFrameHandle * handle = nullptr);
+
+    /** Queue frames that need to be transmitted as a unit
+      * @param frames  frames to send, only daliFrame::bits and daliFrame::data are used
+      * @param count   number of frames (1 to #DALI_SEQUENCE_SIZE)
+      * @param handle  optional, receives the handle of the last frame
+      * @param reuse_dtr  leave out DTR writes, see below
+      * @param dtr_epoch  if not negative, the frames rely on DTRs written before and are only sent if dtrChanges()
+      *                   still returns this value when the first one is due, otherwise all complete with DALI_COLLISION
+      * @return DALI_SENT if queued, DALI_BUSY if the queue hasn't room for all of them or DALI_INVALID_PARAMETER
+      *
+      * The frames are queued at once and sent back-to-back with the minimum settling time. If one of them fails to
+      * transmit (DALI_COLLISION, DALI_PULLDOWN or DALI_CANT_BE_HIGH) or a frame of another participant gets in between,
+      * the remaining ones aren't sent and complete with the same error, DALI_COLLISION for a frame in between.
+      *
+      * With @p reuse_dtr, SET_DTR, SET_DTR1 and SET_DTR2 frames (except the last frame) are left out if the register
+      * already holds the value, see dtrHolds(). If the registers may have changed by the time the sequence is due, it
+      * isn't sent and completes with DALI_COLLISION. */
+    daliReturnValue sendSequence(const daliFrame * frames, uint8_t count, daliFrameHandle * handle = nullptr,
+                                 bool reuse_dtr = false, int16_t dtr_epoch = -1);
+
+    /** Check if DTR @p reg (0-2) will hold @p value once the queued frames have been sent
+      *
+      * Values are taken from own SET_DTR, SET_DTR1 and SET_DTR2 frames when they are queued. All of them are
+      * forgotten when another participant sends a frame, an own DTR write fails or the bus is pulled down; own
+      * commands that change DTRs in the control gear (e.g. READ MEMORY LOCATION) forget them as well. */
+    bool dtrHolds(uint8_t reg, uint8_t value) const;
+
+    /** Counter incremented whenever the DTRs of the control gear may have been changed by anything else than the
+      * frames queued here (frames of other participants, failed DTR writes, bus pulldown). DTRs written earlier still
+      * hold as long as it doesn't change. */
+    uint8_t dtrChanges() const { return dtrEpoch; }
+
+    /** Like dtrChanges(), but only counting what may have changed DTR @p reg (0-2)
+      *
+      * Frames of other participants that leave DTR1 and DTR2 alone (e.g. SET DTR0) don't count for them once they
+      * have been decoded. */
+    uint8_t dtrChanges(uint8_t reg) const { return reg == 0 ? dtrEpoch : (uint8_t)(dtrEpoch - dtrKept); }
+
+    /** Update the level of a pending direct arc power frame to @p address instead of queueing a new one
+      * @param address  address byte of the frame (short, group or broadcast address with the selector bit cleared)
+      * @param level    new arc power level
+      * @param handle   optional, receives the handle of the updated frame
+      * @return false if there is no such frame or updating it could change the outcome, see DaliClass::sendArc() */
+    bool supersedeArc(byte address, byte level, daliFrameHandle * handle = nullptr);
+
+    /** Get result of a queued frame
+      * @param handle  handle returned by sendRaw()
+      * @return DALI_PENDING while queued or in transmission, then either the response, DALI_RX_EMPTY or any
+      *         of ::daliReturnValue on error. DALI_INVALID_PARAMETER if the handle's slot has already been reused,
+      *         so results need to be collected within #DALI_TX_QUEUE_SIZE subsequent frames. */
+    int getResult(daliFrameHandle handle);
+
+    /** Number of frames that can be queued right now, calls pending completion callbacks */
+    uint8_t txQueueFree();
+
+    /** Set completion callback for a queued frame
+      * @param handle    handle returned by sendRaw()
+      * @param callback  called from loop() (or sendRaw()/txQueueFree()) with the frame's result once completed
+      * @param context   passed to @p callback
+      * @return false if the frame's callback has already been dispatched or the handle has expired */
+    bool onComplete(daliFrameHandle handle, EventHandlerCompletedFuncPtr callback, void * context = nullptr);
 
     int getLastResponse();
 
+    /** Get next frame received from other bus participants
+      * @param frame  receives the frame
+      * @return false if no frame is available
+      *
+      * The ISRs only record edge timestamps (#DALI_EDGE_QUEUE_SIZE) and frame boundaries (#DALI_RX_QUEUE_SIZE), frames
+      * are decoded by this function and the other functions called from the main loop. Decoded frames are buffered in a
+      * ring of #DALI_RX_QUEUE_SIZE entries, if it isn't drained in time newer frames are dropped. Backward frames to our
+      * own queries aren't stored, see getResult(). */
+    bool receive(daliFrame & frame);
+
+    /** Number of received frames waiting to be fetched with receive() */
+    uint8_t available();
+
+    /** Dispatch completion callbacks and hand received frames to #receivedCallback, #monitorCallback and #events,
+      * needs to be called from the main loop if callbacks are used */
+    void loop();
+
 #ifdef ARDUINO_ARCH_ESP32
     void fastWrite(uint8_t pin, uint8_t value)
     {
@@ -115,44 +331,227 @@ class DaliBusClass {
     }
 #endif
 
+#ifndef DALI_NO_STATS
+    /** Get statistics collected since the last reset
+      * @param stats  receives the statistics
+      * @param reset  start a new period afterwards
+      *
+      * Interrupts are only disabled while the counters written by the ISRs are copied. */
+    void getStats(daliBusStats & stats, bool reset = false);
+
+    /** Clear all statistics and start a new period */
+    void resetStats();
+#endif
+
+    /** true if bus is idle and no frames are queued */
     bool busIsIdle();
-    volatile byte busIdleCount;
+
+    /** true if no frames are queued and the bus has been idle for the settling time of @p priority and its random part,
+      * so no other master of that priority class will start a frame any more */
+    bool busIsSettled(daliPriority priority) const {
+      return busState == IDLE && txQueueTail == txQueueHead && busIdleCount >= settlingTicks[priority] + 2;
+    }
+
+    /** µs since the last edge on the bus, wraps after 2^32 ticks of the edge timestamp counter (about 18 s on ESP32) */
+    unsigned long idleTime();
+
+    /** half-bits since the last edge, stops counting at settlingTicks[DALI_PRIORITY_POLL] + 2 (53, settled) while the
+      * timer is stopped, see #DALI_NO_TICKLESS */
+    volatile byte busIdleCount = 0;
 
     void timerISR();
     void pinchangeISR();
-    EventHandlerReceivedDataFuncPtr receivedCallback;
-    EventHandlerActivityFuncPtr activityCallback;
-    EventHandlerErrorFuncPtr errorCallback;
 
-    //TODO remove temp
-    bool tempBusLevel = false;
-    uint16_t tempDelta = 0;
+    /** Call timerISR() of all started buses */
+    static void timerISRAll();
+
+    /** started buses, used for interrupt dispatch */
+    static DaliBusClass * instances[DALI_MAX_BUSES];
+    static volatile uint8_t instanceCount;
+
+    /** true while the timer is stopped because all buses are idle, see #DALI_NO_TICKLESS */
+    static volatile bool timerSleeping;
+    EventHandlerReceivedDataFuncPtr receivedCallback = nullptr;
+    EventHandlerActivityFuncPtr activityCallback = nullptr;
+    /** Called on bus errors, from the ISRs for DALI_COLLISION, DALI_PULLDOWN and DALI_CANT_BE_HIGH, from the main loop
+      * (the decoder) for reception errors */
+    EventHandlerErrorFuncPtr errorCallback = nullptr;
+
+    /** Called from the main loop for every frame seen on the bus: own frames once completed with their result as
+      * @p response, received frames (including those of other masters) when taken from the receive queue with
+      * @p response set to DALI_PENDING. Also see DaliClass::setMonitor() */
+    EventHandlerMonitorFuncPtr monitorCallback = nullptr;
+    void * monitorContext = nullptr;
+
+    /** Recorder of all frames, set by DaliTrace::begin() */
+    DaliTrace * trace = nullptr;
+
+    /** Dispatcher of input device events, set by DaliEvents::begin() */
+    DaliEvents * events = nullptr;
+
+    /** Priority class of the frames queued from now on, frames of a sequence after the first one always use
+      * DALI_PRIORITY_TRANSACTION. A frame that collides with one of another master is sent again after a random
+      * backoff, up to #DALI_COLLISION_RETRIES times, before it completes with DALI_COLLISION. */
+    daliPriority priority = DALI_PRIORITY_USER;
 
   protected:
     byte txPin, rxPin;
     bool activeLow;
-    byte txMessage[4];
-    uint8_t txLength;
+    const uint8_t * txWave;   // half-bit levels of the frame being transmitted, see txEncode()
+    uint8_t txWaveBits;       // current byte of txWave, shifted left with each half-bit
+    uint8_t txHalf;           // half-bits sent
+    uint8_t txHalves;         // half-bits to send
 
     enum busStateEnum {
-      TX_START_1ST, TX_START_2ND,
-      TX_BIT_1ST, TX_BIT_2ND,
-      TX_STOP_1ST, TX_STOP,
+      TX_WAVE, TX_STOP,
       IDLE,
       SHORT,
-      WAIT_RX, RX_START, RX_BIT, RX_STOP
+      WAIT_RX, RX
     };
     volatile busStateEnum busState;
-    volatile byte txPos;
     volatile byte txBusLevel;
     volatile byte txCollision;
 
-    volatile unsigned long rxLastChange;
-    volatile byte rxMessage;
-    volatile uint32_t rxCommand;
-    volatile char rxLength;
-    volatile char rxError;
+    volatile uint32_t rxLastEdge;     // getEdgeTime of the last edge
     volatile bool rxIsResponse = false;
+    volatile bool rxOverrun = false;  // edges of the current frame have been lost
+    volatile uint8_t rxFrameStart;    // rxEdgeHead at the start of the current frame
+
+    // edge timestamps in getEdgeTime ticks with bit 0 replaced by the bus level after the edge
+    volatile uint32_t rxEdges[DALI_EDGE_QUEUE_SIZE];
+    volatile uint8_t rxEdgeHead = 0; // only written by pinchangeISR()
+    volatile uint8_t rxEdgeTail = 0; // only written by decode()
+
+    // received frames waiting to be decoded
+    struct rxMark {
+      uint8_t edgeStart, edgeEnd;   // range in rxEdges
+      bool response;                // backward frame to the frame at handle
+      bool foreign;                 // sent by another participant, dtrEpoch has been incremented for it
+      bool overrun;
+      daliFrameHandle handle;
+    };
+    volatile rxMark rxMarks[DALI_RX_QUEUE_SIZE];
+    volatile uint8_t rxMarkHead = 0; // only written by the ISRs
+    volatile uint8_t rxMarkTail = 0; // only written by decode()
+
+    daliFrame rxQueue[DALI_RX_QUEUE_SIZE];
+    uint8_t rxQueueHead = 0; // next slot to fill, only written by decode()
+    uint8_t rxQueueTail = 0; // next slot to fetch, only written by receive()
+    daliFrameHandle lastResponseHandle = 0xFF; // frame already reported by getLastResponse()
+    uint8_t ticksPerUs = 1;  // of getEdgeTime
+
+    struct txFrame {
+      volatile byte message[3];
+      uint8_t wave[7];                                  // bus level of each half-bit (1: high), see txEncode()
+      volatile uint8_t bits;
+      volatile daliFrameHandle handle;
+      volatile int result;
+      EventHandlerCompletedFuncPtr callback; // only used outside of ISRs
+      void * context;
+      volatile uint32_t times[DALI_LATENCY_STAGES + 1]; // getEdgeTime at the start of each stage and the end of the last
+      volatile uint8_t stage;                           // stages completed
+      uint8_t flags;                                    // TX_SEQUENCE_*, TX_DTR_*
+      uint8_t dtrEpoch;                                 // dtrEpoch when queued, for TX_DTR_REUSED
+      uint8_t settle;                                   // idle ticks before sending, by priority
+    };
+    static const uint8_t TX_SEQUENCE_NEXT = 1; // followed by another frame of the same sequence
+    static const uint8_t TX_SEQUENCE_PREV = 2; // continues a sequence
+    static const uint8_t TX_DTR_WRITE = 4;     // sets a DTR
+    static const uint8_t TX_DTR_REUSED = 8;    // first frame of a sequence relying on DTRs written before
+    static const uint8_t TX_NO_ANSWER = 16;    // completes without waiting for a backward frame, see commandFlags()
+    txFrame txQueue[DALI_TX_QUEUE_SIZE];
+    volatile uint8_t txQueueHead = 0; // next slot to fill, only written by sendRaw()
+    volatile uint8_t txQueueTail = 0; // next/current slot to send, only written by the ISRs
+    uint8_t txQueueDone = 0;          // next completed slot to dispatch callback for
+    bool txDispatching = false;
+    volatile bool txActive = false;   // frame at txQueueTail is being transmitted
+    volatile bool txSequence = false; // frame at txQueueTail continues the sequence of the frame just completed
+    uint8_t txCollisions = 0;         // of the frame at txQueueTail
+    uint8_t txBackoff = 0;            // extra idle ticks before the frame at txQueueTail is sent (jitter, backoff)
+    uint16_t txRandom = 1;            // state of the backoff random generator
+    static const uint8_t settlingTicks[6]; // by ::daliPriority
+
+    volatile uint8_t dtrEpoch = 0;    // incremented by the ISRs whenever DTRs may differ from what was queued
+    uint8_t dtrKept = 0;              // decoded frames of other participants leaving DTR1 and DTR2 alone
+    uint8_t dtrValues[3];             // DTR0-2 after the queued frames, see dtrHolds()
+    uint8_t dtrValid = 0;             // bit per register
+    uint8_t dtrValidEpoch = 0;        // dtrEpoch the values are valid for
+    uint8_t txEnabledType = 0xFF;     // device type enabled by the last queued frame (ENABLE DEVICE TYPE)
+
+#ifndef DALI_NO_STATS
+    daliBusStats stats;          // counters and histograms, derived values are filled in by getStats()
+    unsigned long statsStart = 0; // millis() at the last reset
+    volatile uint32_t busyTicks = 0;
+    volatile uint64_t isrTicks = 0;    // sum of interrupt handler execution times
+    volatile uint32_t isrTicksMax = 0;
+    void countError(daliReturnValue error) { stats.errors[-error]++; }
+    void countLatency(daliLatencyStage stage, uint32_t ticks);
+#else
+    void countError(daliReturnValue error) {}
+#endif
+
+    unsigned long edgeMicros(uint32_t time) { return micros() - (uint32_t)(getEdgeTime - time) / ticksPerUs; }
+    void dispatchCompleted();
+    static void timerWake();
+    void txStartNext();
+    void txComplete(int result);
+    void txAbortSequence(int result);
+    void txCollided();
+    uint8_t txRandomTicks();
+    daliReturnValue txFill(uint8_t index, const byte * message, uint8_t bits, uint8_t flags);
+    static void txEncode(txFrame & frame);
+    static int8_t dtrWritten(const byte * message, uint8_t bits);
+    uint8_t commandFlags(const byte * message, uint8_t bits) const;
+    static bool isValidLength(uint8_t bits) { return bits != 0 && bits <= 25 && (bits == 25 || bits % 8 == 0); }
+    void timerTick();
+    void edgeISR(uint32_t time);
+    void rxEnd();
+    void decode();
+    void decodeFrame(uint8_t start, uint8_t end, daliFrame & frame);
 };
 
 extern DaliBusClass DaliBus;
+
+/** Pending result of a frame sent asynchronously, see DaliClass::sendCmdAsync()
+  *
+  * With C++20 a transaction can be awaited from a coroutine, which is resumed from DaliBusClass::loop():
+  * @code int level = co_await Dali.sendCmdAsync(3, DaliCmd::QUERY_ACTUAL_LEVEL); @endcode */
+class DaliTransaction {
+  public:
+    /** Transaction that couldn't be started, its result is @p error */
+    DaliTransaction(daliReturnValue error = DALI_INVALID_PARAMETER) : bus(nullptr), handle(0), error(error) {}
+    DaliTransaction(DaliBusClass & bus_instance, daliFrameHandle frame) : bus(&bus_instance), handle(frame), error(DALI_NO_ERROR) {}
+
+    /** true if the frame has been completed or couldn't be queued */
+    bool ready() const { return result() != DALI_PENDING; }
+
+    /** DALI_PENDING while in progress, then the response, DALI_RX_EMPTY or any of ::daliReturnValue on error */
+    int result() const;
+
+    /** Wait for completion
+      * @param timeout  time in ms to wait
+      * @return result() or DALI_SEND_TIMEOUT */
+    int wait(byte timeout = 50) const;
+
+    /** Call @p callback from DaliBusClass::loop() once completed, or right away if already completed */
+    void then(EventHandlerCompletedFuncPtr callback, void * context = nullptr) const;
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+    bool await_ready() const { return ready(); }
+    bool await_suspend(std::coroutine_handle<> waiter) const {
+      return bus != nullptr && bus->onComplete(handle, resume, waiter.address());
+    }
+    int await_resume() const { return result(); }
+#endif
+
+  protected:
+    DaliBusClass * bus;
+    daliFrameHandle handle;
+    daliReturnValue error;
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+    static void resume(daliFrameHandle frame, int result, void * context) {
+      std::coroutine_handle<>::from_address(context).resume();
+    }
+#endif
+};
@@ -0,0 +1,78 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliColour.h"
+
+int DaliColour::setColourTemperature(byte address, uint16_t mirek, byte addr_type, bool activate, byte timeout) {
+  DaliSequence sequence(dali);
+  sequence.reuseDtr(reuseDtr).dtr(0, mirek & 0xFF).dtr(1, mirek >> 8);
+  addCommand(sequence, address, SET_TEMP_COLOUR_TEMPERATURE, addr_type);
+  return send(sequence, address, addr_type, activate, timeout);
+}
+
+int DaliColour::setXY(byte address, uint16_t x, uint16_t y, byte addr_type, bool activate, byte timeout) {
+  DaliSequence sequence(dali);
+  sequence.reuseDtr(reuseDtr).dtr(0, x & 0xFF).dtr(1, x >> 8);
+  addCommand(sequence, address, SET_COORDINATE_X, addr_type);
+  int result = sequence.sendWait(timeout);
+  if (result != DALI_RX_EMPTY) return result;
+
+  sequence.clear().dtr(0, y & 0xFF).dtr(1, y >> 8);
+  addCommand(sequence, address, SET_COORDINATE_Y, addr_type);
+  return send(sequence, address, addr_type, activate, timeout);
+}
+
+int DaliColour::setRGBWAF(byte address, const uint8_t * levels, byte addr_type, bool activate, byte timeout) {
+  DaliSequence sequence(dali);
+  sequence.reuseDtr(reuseDtr);
+  for (byte part = 0; part < 2; part++) {
+    const uint8_t * channels = levels + 3 * part;
+    if (channels[0] == 255 && channels[1] == 255 && channels[2] == 255) continue;
+    if (sequence.size() > 0) {
+      int result = sequence.sendWait(timeout);
+      if (result != DALI_RX_EMPTY) return result;
+      sequence.clear();
+    }
+    sequence.dtr(0, channels[0]).dtr(1, channels[1]).dtr(2, channels[2]);
+    addCommand(sequence, address, part ? SET_TEMP_WAF_LEVEL : SET_TEMP_RGB_LEVEL, addr_type);
+  }
+  return send(sequence, address, addr_type, activate, timeout);
+}
+
+int DaliColour::activate(byte address, byte addr_type, byte timeout) {
+  DaliSequence sequence(dali);
+  return send(sequence, address, addr_type, true, timeout);
+}
+
+void DaliColour::addCommand(DaliSequence & sequence, byte address, DaliCmdExtendedDT8 command, byte addr_type) {
+  // ENABLE DEVICE TYPE only applies to the next command
+  sequence.special(DaliSpecialCmd::ENABLE_DT, 8).cmd(address, (DaliCmd)command, addr_type);
+}
+
+// append ACTIVATE if requested and send what's left, in two parts if it doesn't fit into a single sequence
+int DaliColour::send(DaliSequence & sequence, byte address, byte addr_type, bool activate, byte timeout) {
+  if (activate) {
+    if (sequence.size() + 2 > DALI_SEQUENCE_SIZE) {
+      int result = sequence.sendWait(timeout);
+      if (result != DALI_RX_EMPTY) return result;
+      sequence.clear();
+    }
+    addCommand(sequence, address, ACTIVATE, addr_type);
+  }
+  if (sequence.size() == 0) return DALI_RX_EMPTY;
+  return sequence.sendWait(timeout);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliColour.h
+ * @brief Colour control of DT8 control gear
+ *
+ * Sets colour temperature, xy coordinate or RGBWAF levels of short addresses, groups or all gear. The values are
+ * written to DTR0-2 and taken over with the respective DT8 command, each preceded by ENABLE DEVICE TYPE 8, in a
+ * DaliSequence. DTR writes of registers already holding the value are left out (see DaliBusClass::dtrHolds()), so
+ * e.g. a colour temperature sweep needs one frame less per step while the high byte doesn't change and the same
+ * step for further groups needs two frames less.
+ */
+
+#include "Dali.h"
+
+class DaliColour {
+  public:
+    /** Create colour control for the bus of @p dali_instance */
+    DaliColour(DaliClass & dali_instance = Dali) : dali(dali_instance) {}
+
+    /** Set colour temperature
+      * @param  address    short or group address, 0xFF with DaliAddressTypes::GROUP for broadcast
+      * @param  mirek      colour temperature in mirek, see mirek()
+      * @param  addr_type  address type (short/group)
+      * @param  activate   take the colour over right away, otherwise it's kept as temporary colour until activate()
+      *                    or an arc power command (if the gear supports automatic activation)
+      * @param  timeout    time in ms to wait per frame
+      * @return DALI_RX_EMPTY once sent or any of ::daliReturnValue on error, see DaliSequence::sendWait() */
+    int setColourTemperature(byte address, uint16_t mirek, byte addr_type = DaliAddressTypes::SHORT,
+                             bool activate = true, byte timeout = 50);
+
+    /** Set CIE 1931 xy coordinate, @p x and @p y in units of 1/65536, see setColourTemperature() */
+    int setXY(byte address, uint16_t x, uint16_t y, byte addr_type = DaliAddressTypes::SHORT, bool activate = true,
+              byte timeout = 50);
+
+    /** Set primary levels, @p levels are red, green, blue, white, amber and freecolour, 255 (MASK) keeps a level.
+      * The RGB or WAF part isn't sent at all if all three of its levels are MASK. See setColourTemperature(). */
+    int setRGBWAF(byte address, const uint8_t * levels, byte addr_type = DaliAddressTypes::SHORT, bool activate = true,
+                  byte timeout = 50);
+
+    /** Take over the temporary colour, see setColourTemperature() */
+    int activate(byte address, byte addr_type = DaliAddressTypes::SHORT, byte timeout = 50);
+
+    /** Convert colour temperature from Kelvin to mirek */
+    static uint16_t mirek(uint16_t kelvin) { return kelvin ? 1000000UL / kelvin : 0xFFFF; }
+
+    /** Leave out DTR writes of values the DTRs are known to hold, see DaliSequence::reuseDtr() */
+    bool reuseDtr = true;
+
+  protected:
+    DaliClass & dali;
+
+    void addCommand(DaliSequence & sequence, byte address, DaliCmdExtendedDT8 command, byte addr_type);
+    int send(DaliSequence & sequence, byte address, byte addr_type, bool activate, byte timeout);
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 /** DALI commands */
 enum DaliCmd {
   OFF = 0, UP = 1, DOWN = 2, STEP_UP = 3, STEP_DOWN = 4,
@@ -12,7 +14,7 @@ enum DaliCmd {
   DTR_AS_EXT_FADE_TIME = 48, // DALI-2
   DTR_AS_SCENE = 64, REMOVE_FROM_SCENE = 80,
   ADD_TO_GROUP = 96, REMOVE_FROM_GROUP = 112,
-  DTR_AS_SHORT = 128,
+  DTR_AS_SHORT = 128, ENABLE_WRITE_MEM = 129,
   QUERY_STATUS = 144, QUERY_BALLAST = 145, QUERY_LAMP_FAILURE = 146, QUERY_LAMP_POWER_ON = 147, QUERY_LIMIT_ERROR = 148,
   QUERY_RESET_STATE = 149, QUERY_MISSING_SHORT = 150, QUERY_VERSION = 151, QUERY_DTR = 152, QUERY_DEVICE_TYPE = 153,
   QUERY_PHYS_MIN = 154, QUERY_POWER_FAILURE = 155,
@@ -21,7 +23,8 @@ enum DaliCmd {
   QUERY_SPECMODE = 166, QUERY_NEXT_DEVTYPE = 167, QUERY_EXT_FADE_TIME = 168, QUERY_CTRL_GEAR_FAIL = 169, // DALI-2
   QUERY_SCENE_LEVEL = 176,
   QUERY_GROUPS_0_7 = 192, QUERY_GROUPS_8_15 = 193,
-  QUERY_ADDRH = 194, QUERY_ADDRM = 195, QUERY_ADDRL = 196
+  QUERY_ADDRH = 194, QUERY_ADDRM = 195, QUERY_ADDRL = 196,
+  READ_MEM_LOC = 197
 };
 
 /** DALI special commands */
@@ -89,4 +92,86 @@ enum class DaliDevTypes {
 enum DaliAddressTypes {
   SHORT = 0,
   GROUP = 1
-};
\ No newline at end of file
+};
+
+/** Properties of a command, see daliCommandInfo */
+enum DaliCommandFlags {
+  DALI_CMD_ANSWER = 0x01,      /**< control gear may answer, reserved and unknown commands are assumed to */
+  DALI_CMD_TWICE = 0x02,       /**< only executed when received twice within 100 ms */
+  DALI_CMD_USES_DTR0 = 0x04,
+  DALI_CMD_USES_DTR1 = 0x08,
+  DALI_CMD_USES_DTR2 = 0x10,
+  DALI_CMD_CHANGES_DTR = 0x20  /**< control gear changes DTRs on its own */
+};
+
+/** Command metadata, see daliCmdInfo(), daliSpecialCmdInfo() and daliDT8CmdInfo() */
+typedef struct daliCommandInfo {
+  uint8_t flags;      /**< DaliCommandFlags */
+  uint8_t deviceType; /**< device type that must be enabled with ENABLE_DT before, 0xFF for none */
+} daliCommandInfo;
+
+/** Flags of a command, a constant expression for constant commands */
+constexpr uint8_t daliCmdFlags(int command) {
+  return command == 9 || (command > GO_TO_LAST && command < GO_TO_SCENE) ? DALI_CMD_ANSWER : // reserved
+    command < 32 ? 0 :
+    command == ARC_TO_DTR ? DALI_CMD_TWICE | DALI_CMD_CHANGES_DTR :
+    command == SET_OPMODE || command == RESET_MEM ? DALI_CMD_TWICE | DALI_CMD_USES_DTR0 :
+    command <= IDENTIFY ? DALI_CMD_TWICE :
+    command < 42 ? DALI_CMD_TWICE | DALI_CMD_ANSWER : // reserved
+    command <= 48 ? DALI_CMD_TWICE | DALI_CMD_USES_DTR0 :
+    command < 64 ? DALI_CMD_TWICE | DALI_CMD_ANSWER : // reserved
+    command < 80 ? DALI_CMD_TWICE | DALI_CMD_USES_DTR0 :
+    command < 128 ? DALI_CMD_TWICE :
+    command == DTR_AS_SHORT ? DALI_CMD_TWICE | DALI_CMD_USES_DTR0 :
+    command == ENABLE_WRITE_MEM ? DALI_CMD_TWICE :
+    command == QUERY_DTR ? DALI_CMD_ANSWER | DALI_CMD_USES_DTR0 :
+    command == 156 ? DALI_CMD_ANSWER | DALI_CMD_USES_DTR1 : // QUERY CONTENT DTR1
+    command == 157 ? DALI_CMD_ANSWER | DALI_CMD_USES_DTR2 : // QUERY CONTENT DTR2
+    command == READ_MEM_LOC ? DALI_CMD_ANSWER | DALI_CMD_USES_DTR0 | DALI_CMD_USES_DTR1 | DALI_CMD_CHANGES_DTR :
+    DALI_CMD_ANSWER; // queries, reserved commands, and application extended commands of unknown device type
+}
+
+/** Metadata of a command (second byte of a command frame) */
+constexpr daliCommandInfo daliCmdInfo(DaliCmd command) {
+  return daliCommandInfo{ daliCmdFlags(command), 0xFF };
+}
+
+/** Flags of a special command (256 - 287) */
+constexpr uint8_t daliSpecialCmdFlags(int command) {
+  return command == INITIALISE || command == RANDOMISE ? DALI_CMD_TWICE :
+    command == COMPARE || command == VERIFYSHORT || command == QUERY_SHORT ? DALI_CMD_ANSWER :
+    command == WRITE_MEM_LOC ? DALI_CMD_ANSWER | DALI_CMD_USES_DTR0 | DALI_CMD_USES_DTR1 | DALI_CMD_CHANGES_DTR :
+    command == WRITE_MEM_LOC_NOREPLY ? DALI_CMD_USES_DTR0 | DALI_CMD_USES_DTR1 | DALI_CMD_CHANGES_DTR :
+    (command >= TERMINATE && command <= 262) || (command >= SEARCHADDRH && command <= PHYS_SEL) ||
+    (command >= ENABLE_DT && command <= SET_DTR2) ? 0 : // 262: PING
+    DALI_CMD_ANSWER; // reserved
+}
+
+/** Metadata of a special command */
+constexpr daliCommandInfo daliSpecialCmdInfo(DaliSpecialCmd command) {
+  return daliCommandInfo{ daliSpecialCmdFlags(command), 0xFF };
+}
+
+/** Flags of a DT8 extended command (224 - 255) */
+constexpr uint8_t daliDT8CmdFlags(int command) {
+  return command == SET_COORDINATE_X || command == SET_COORDINATE_Y || command == SET_TEMP_COLOUR_TEMPERATURE ?
+      DALI_CMD_USES_DTR0 | DALI_CMD_USES_DTR1 :
+    command >= SET_TEMP_PRIMARY_LEVEL && command <= SET_TEMP_WAF_LEVEL ?
+      DALI_CMD_USES_DTR0 | DALI_CMD_USES_DTR1 | DALI_CMD_USES_DTR2 :
+    command == SET_TEMP_RGBWAF_LEVEL ? DALI_CMD_USES_DTR0 :
+    command == STORE_TY_PRIMARY ? DALI_CMD_TWICE | DALI_CMD_USES_DTR0 | DALI_CMD_USES_DTR1 | DALI_CMD_USES_DTR2 :
+    command == STORE_XY_COORDINATE_PRIMARY ? DALI_CMD_TWICE | DALI_CMD_USES_DTR2 :
+    command == STORE_COLOUR_TEMPERATURE_LIMIT ?
+      DALI_CMD_TWICE | DALI_CMD_USES_DTR0 | DALI_CMD_USES_DTR1 | DALI_CMD_USES_DTR2 :
+    command == STORE_GEAR_FEATURES || command == ASSIGN_COLOUR_TO_LINKED_CHANNEL ? DALI_CMD_TWICE | DALI_CMD_USES_DTR0 :
+    command == START_AUTO_CALIBRATION ? DALI_CMD_TWICE :
+    command == QUERY_COLOUR_VALUE ? DALI_CMD_ANSWER | DALI_CMD_USES_DTR0 | DALI_CMD_CHANGES_DTR :
+    command == QUERY_COLOUR_ASSIGNED_COLOUR ? DALI_CMD_ANSWER | DALI_CMD_USES_DTR0 :
+    command >= QUERY_GEAR_FEATURES || command == 239 || command == 244 ? DALI_CMD_ANSWER : // incl. reserved
+    0;
+}
+
+/** Metadata of a DT8 extended command */
+constexpr daliCommandInfo daliDT8CmdInfo(DaliCmdExtendedDT8 command) {
+  return daliCommandInfo{ daliDT8CmdFlags(command), 8 };
+}
@@ -0,0 +1,366 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliCommissioner.h"
+
+void DaliCommissioner::load(const DaliInventory & inventory) {
+  known = 0;
+  for (byte i = 0; i < 64; i++)
+    if (inventory.isPresent(i) && !(inventory.incomplete & (1ULL << i)))
+      setDevice(i, inventory.devices[i].randomAddress);
+}
+
+void DaliCommissioner::setDevice(byte address, uint32_t randomAddress) {
+  address &= 0x3F;
+  randomAddresses[address] = randomAddress & 0xFFFFFF;
+  known |= 1ULL << address;
+}
+
+bool DaliCommissioner::start() {
+  if (busy()) return false;
+
+  unchecked = ~0ULL;
+  retried = taken = identify = 0;
+  changed = conflicts = missing = 0;
+  inFlightHead = inFlightTail = 0;
+  status = DALI_NO_ERROR;
+  state = COMMISSIONER_CHECK;
+  return true;
+}
+
+bool DaliCommissioner::tick() {
+  if (state == COMMISSIONER_OFF) return false;
+  if (state == COMMISSIONER_CHECK) {
+    checkTick();
+    return busy();
+  }
+
+  if (!queued) {
+    transaction = sequence.send();
+    if (transaction.result() == DALI_BUSY) return true;
+    queued = true;
+  }
+  int result = transaction.result();
+  if (result == DALI_PENDING) return true;
+
+  // frames that have not been transmitted are sent again
+  if (result < 0 && result != DALI_RX_EMPTY && result != DALI_RX_ERROR) {
+    if (++retries <= MAX_RETRIES) {
+      queued = false;
+      return true;
+    }
+    if (state == COMMISSIONER_TERMINATE || state == COMMISSIONER_IDENTIFY) {
+      finish(result);
+    } else {
+      status = result;
+      sequence.clear().special(DaliSpecialCmd::TERMINATE);
+      send(COMMISSIONER_TERMINATE);
+    }
+    return busy();
+  }
+  retries = 0;
+  handleResult(result);
+  return busy();
+}
+
+// ask all short addresses for the low byte of their random address, pipelined through the transmit queue
+void DaliCommissioner::checkTick() {
+  while (inFlightTail != inFlightHead) {
+    checkQuery &query = inFlight[inFlightTail & (PIPELINE - 1)];
+    int result = query.transaction.result();
+    if (result == DALI_PENDING) break;
+    inFlightTail++;
+    handleCheck(query.address, result);
+  }
+
+  while (unchecked != 0 && (uint8_t)(inFlightHead - inFlightTail) < PIPELINE) {
+    byte address = 0;
+    while (!((unchecked >> address) & 1)) address++;
+    DaliTransaction query = dali.sendCmdAsync(address, DaliCmd::QUERY_ADDRL);
+    if (query.result() == DALI_BUSY) break;
+    inFlight[inFlightHead & (PIPELINE - 1)].transaction = query;
+    inFlight[inFlightHead & (PIPELINE - 1)].address = address;
+    inFlightHead++;
+    unchecked &= ~(1ULL << address);
+  }
+
+  if (unchecked == 0 && inFlightHead == inFlightTail) {
+    unresolved = conflicts;
+    nextIdentify();
+  }
+}
+
+void DaliCommissioner::handleCheck(byte address, int result) {
+  uint64_t bit = 1ULL << address;
+  if (result < 0 && result != DALI_RX_EMPTY && result != DALI_RX_ERROR) {
+    if (!(retried & bit)) {
+      retried |= bit;
+      unchecked |= bit;
+    } else {
+      taken |= bit; // unknown, left alone
+    }
+    return;
+  }
+
+  if (result == DALI_RX_EMPTY) {
+    if (known & bit) missing |= bit;
+    return;
+  }
+  taken |= bit;
+  if (result == DALI_RX_ERROR) // several devices answering at once
+    conflicts |= bit;
+  else if (!(known & bit) || (int)(randomAddresses[address] & 0xFF) != result)
+    identify |= bit;
+}
+
+// read the whole random address of the next device not known yet
+void DaliCommissioner::nextIdentify() {
+  if (identify == 0) {
+    nextTarget();
+    return;
+  }
+  byte address = 0;
+  while (!((identify >> address) & 1)) address++;
+  readByte = 2;
+  reading = 0;
+  sequence.clear().cmd(address, DaliCmd::QUERY_ADDRH);
+  send(COMMISSIONER_IDENTIFY);
+}
+
+// resolve the next conflict, then search devices without short address
+void DaliCommissioner::nextTarget() {
+  sequence.clear();
+  if (unresolved != 0) {
+    target = 0;
+    while (!((unresolved >> target) & 1)) target++;
+    unresolved &= ~(1ULL << target);
+    sequence.special(DaliSpecialCmd::INITIALISE, (target << 1) | 1);
+    searchSentValid = 0; // devices not initialised before ignore search addresses
+    send(COMMISSIONER_INITIALISE);
+  } else {
+    target = 0xFF;
+    sequence.special(DaliSpecialCmd::INITIALISE, 0xFF).special(DaliSpecialCmd::RANDOMISE);
+    searchSentValid = 0;
+    waiting = false;
+    send(COMMISSIONER_RANDOMISE);
+  }
+}
+
+void DaliCommissioner::handleResult(int result) {
+  bool answered = result >= 0 || result == DALI_RX_ERROR;
+  switch (state) {
+    case COMMISSIONER_IDENTIFY: {
+      byte address = 0;
+      while (!((identify >> address) & 1)) address++;
+      uint64_t bit = 1ULL << address;
+      if (result == DALI_RX_ERROR) conflicts |= bit;
+      if (result < 0) { // gone or sharing the address with another device
+        identify &= ~bit;
+        if (result == DALI_RX_ERROR) unresolved |= bit;
+        nextIdentify();
+        break;
+      }
+      reading |= (uint32_t)result << (8 * readByte);
+      if (readByte-- > 0) {
+        sequence.clear().cmd(address, readByte == 1 ? DaliCmd::QUERY_ADDRM : DaliCmd::QUERY_ADDRL);
+        send(COMMISSIONER_IDENTIFY);
+        break;
+      }
+      identify &= ~bit;
+      if (!(known & bit) || randomAddresses[address] != reading) {
+        setDevice(address, reading);
+        changed |= bit;
+      }
+      nextIdentify();
+      break;
+    }
+
+    case COMMISSIONER_INITIALISE:
+      if (known & (1ULL << target)) { // the known device keeps its short address
+        sequence.clear();
+        addSearchAddress(randomAddresses[target]);
+        sequence.special(DaliSpecialCmd::WITHDRAW);
+        send(COMMISSIONER_WITHDRAW);
+        break;
+      }
+      // fall through
+    case COMMISSIONER_WITHDRAW:
+      searchLow = 0;
+      withdraw = false;
+      nextSearch();
+      break;
+
+    case COMMISSIONER_RANDOMISE:
+      // wait 100 ms for the random addresses to be generated
+      if (!waiting) {
+        waiting = true;
+        randomised = millis();
+      }
+      if (millis() - randomised < 100) break;
+      searchLow = 0;
+      withdraw = false;
+      nextSearch();
+      break;
+
+    case COMMISSIONER_SEARCH:
+      if (answered) // at least one device at or below search address
+        searchFound = true;
+      else if (searchBit < 0 || probing) { // final check, no device left
+        sequence.clear().special(DaliSpecialCmd::TERMINATE);
+        send(COMMISSIONER_TERMINATE);
+        break;
+      } else
+        searchPrefix |= 1UL << searchBit;
+      probing = false;
+      searchNextBit();
+      if (searchBit < 0 && searchFound)
+        program();
+      else
+        queueCompare();
+      break;
+
+    case COMMISSIONER_PROGRAM:
+      if (programmed != target) {
+        if (result != 0xFF) {
+          status = DALI_ERROR_VERIFY;
+          sequence.clear().special(DaliSpecialCmd::TERMINATE);
+          send(COMMISSIONER_TERMINATE);
+          break;
+        }
+        missing &= ~(1ULL << programmed);
+        taken |= 1ULL << programmed;
+      }
+      setDevice(programmed, searchAddress);
+      changed |= 1ULL << programmed;
+      withdraw = programmed != target; // not withdrawn yet
+      searchLow = searchAddress + 1; // remaining devices have higher random addresses
+      nextSearch();
+      break;
+
+    case COMMISSIONER_TERMINATE:
+      if (status != DALI_NO_ERROR || target == 0xFF)
+        finish(status);
+      else
+        nextTarget();
+      break;
+
+    default:
+      break;
+  }
+}
+
+void DaliCommissioner::send(commissionerStateEnum next) {
+  state = next;
+  queued = false;
+  retries = 0;
+}
+
+// bitwise search for the lowest random address above the last one found
+void DaliCommissioner::nextSearch() {
+  if (searchLow > 0xFFFFFF) { // last device found had the highest possible address
+    sequence.clear();
+    if (withdraw)
+      sequence.special(DaliSpecialCmd::WITHDRAW);
+    sequence.special(DaliSpecialCmd::TERMINATE);
+    send(COMMISSIONER_TERMINATE);
+    return;
+  }
+  searchPrefix = 0;
+  searchBit = 24;
+  searchFound = false;
+  // first check if there is any device left at all, usually there are only a few new ones
+  probing = true;
+  searchAddress = 0xFFFFFF;
+  queueCompare();
+}
+
+void DaliCommissioner::searchNextBit() {
+  // compare with current bit cleared and all lower bits set, unless no remaining device can be that low
+  while (searchBit > 0) {
+    searchBit--;
+    uint32_t candidate = searchPrefix | ((1UL << searchBit) - 1);
+    if (candidate >= searchLow) {
+      searchAddress = candidate;
+      return;
+    }
+    searchPrefix |= 1UL << searchBit;
+  }
+
+  // all bits known, if no device responded yet it still needs to be confirmed by a final compare
+  searchBit = -1;
+  searchAddress = searchPrefix;
+}
+
+void DaliCommissioner::queueCompare() {
+  sequence.clear();
+  if (withdraw) { // the device found last, the search address still selects it
+    sequence.special(DaliSpecialCmd::WITHDRAW);
+    withdraw = false;
+  }
+  addSearchAddress(searchAddress);
+  sequence.special(DaliSpecialCmd::COMPARE);
+  send(COMMISSIONER_SEARCH);
+}
+
+// the device found keeps the short address of the conflict if no known device has it, else it gets a free one
+void DaliCommissioner::program() {
+  sequence.clear();
+  addSearchAddress(searchAddress);
+  if (target != 0xFF && !(known & (1ULL << target))) {
+    programmed = target;
+    sequence.special(DaliSpecialCmd::WITHDRAW);
+  } else {
+    programmed = freeAddress();
+    if (programmed == 0xFF) {
+      status = DALI_NO_ADDRESS_FREE;
+      sequence.clear().special(DaliSpecialCmd::TERMINATE);
+      send(COMMISSIONER_TERMINATE);
+      return;
+    }
+    sequence.special(DaliSpecialCmd::PROGRAMSHORT, (programmed << 1) | 1)
+            .special(DaliSpecialCmd::VERIFYSHORT, (programmed << 1) | 1);
+  }
+  send(COMMISSIONER_PROGRAM);
+}
+
+// only send search address bytes that have changed
+void DaliCommissioner::addSearchAddress(uint32_t address) {
+  static const DaliSpecialCmd commands[3] = {
+    DaliSpecialCmd::SEARCHADDRL, DaliSpecialCmd::SEARCHADDRM, DaliSpecialCmd::SEARCHADDRH
+  };
+  for (int8_t i = 2; i >= 0; i--) {
+    byte value = (address >> (8 * i)) & 0xFF;
+    if ((searchSentValid & (1 << i)) && ((searchSent >> (8 * i)) & 0xFF) == value) continue;
+    sequence.special(commands[i], value);
+    searchSent = (searchSent & ~(0xFFUL << (8 * i))) | ((uint32_t)value << (8 * i));
+    searchSentValid |= 1 << i;
+  }
+}
+
+byte DaliCommissioner::freeAddress() const {
+  uint64_t unused = ~(known | taken);
+  uint64_t candidates = reuseMissing && missing ? missing : unused;
+  if (candidates == 0) candidates = missing; // only addresses of devices that haven't answered left
+  for (byte i = 0; i < 64; i++)
+    if ((candidates >> i) & 1) return i;
+  return 0xFF;
+}
+
+void DaliCommissioner::finish(int result) {
+  status = result;
+  state = COMMISSIONER_OFF;
+}
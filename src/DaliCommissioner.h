@@ -0,0 +1,140 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliCommissioner.h
+ * @brief Incremental commissioning, keeping the short addresses of the devices already known
+ *
+ * The commissioner keeps a table of the random addresses of the devices known by short address. Each short address is
+ * asked for the low byte of its random address: a garbled answer means several devices share the address, an answer
+ * differing from the table a device not known yet, of which the whole random address is read. Of the devices sharing a
+ * short address, only the ones not known are moved to free addresses: the short address is selected with INITIALISE,
+ * the known device withdrawn and the others searched by random address. Finally devices without short address are
+ * searched and given free addresses. Other devices aren't touched, their short addresses and random addresses stay.
+ */
+
+#include "DaliInventory.h"
+
+#if DALI_SEQUENCE_SIZE < 5
+  #error DaliCommissioner needs a DALI_SEQUENCE_SIZE of at least 5
+#endif
+
+class DaliCommissioner {
+  public:
+    /** Create commissioner for the bus of @p dali_instance */
+    DaliCommissioner(DaliClass & dali_instance = Dali) : dali(dali_instance), sequence(dali_instance) {}
+
+    /** Take the devices and their random addresses from a completed inventory scan (with INVENTORY_RANDOM_ADDRESS) */
+    void load(const DaliInventory & inventory);
+
+    /** Add a device to the table of known devices
+      * @param address        short address
+      * @param randomAddress  its random address */
+    void setDevice(byte address, uint32_t randomAddress);
+
+    /** Start commissioning, which then needs to be driven by calling tick() from the main loop
+      * @return false if commissioning is already running */
+    bool start();
+
+    /** Advance commissioning, needs to be called regularly until it returns false
+      * @return true while commissioning is running */
+    bool tick();
+
+    /** true while commissioning is running */
+    bool busy() const { return state != COMMISSIONER_OFF; }
+
+    /** Result of the last commissioning
+      * @return DALI_NO_ERROR, DALI_PENDING while running or any of ::daliReturnValue on error (DALI_NO_ADDRESS_FREE
+      *         if there are more devices than short addresses, DALI_ERROR_VERIFY if a short address couldn't be set) */
+    int result() const { return busy() ? (int)DALI_PENDING : status; }
+
+    /** Give short addresses of known devices that don't answer to new devices first, so a replacement takes the short
+      * address of the device it replaces. Otherwise they are only used once all other addresses are. */
+    bool reuseMissing = true;
+
+    uint64_t known = 0;          /**< bit per short address with a device in the table */
+    uint32_t randomAddresses[64]; /**< random address of the known device, by short address */
+
+    uint64_t changed = 0;   /**< bit per short address of which the table has been updated by the last commissioning */
+    uint64_t conflicts = 0; /**< bit per short address that several devices have shared */
+    uint64_t missing = 0;   /**< bit per short address of a known device that hasn't answered */
+
+  protected:
+    DaliClass & dali;
+
+    enum commissionerStateEnum {
+      COMMISSIONER_OFF, COMMISSIONER_CHECK, COMMISSIONER_IDENTIFY, COMMISSIONER_INITIALISE, COMMISSIONER_WITHDRAW,
+      COMMISSIONER_RANDOMISE, COMMISSIONER_SEARCH, COMMISSIONER_PROGRAM, COMMISSIONER_TERMINATE
+    };
+    commissionerStateEnum state = COMMISSIONER_OFF;
+    int status = DALI_NO_ERROR;
+
+    // checking short addresses
+    uint64_t unchecked;  // not asked yet
+    uint64_t retried;    // asked again because the frame failed
+    uint64_t taken;      // answered or unknown
+    uint64_t identify;   // answered with a random address not in the table
+    uint64_t unresolved; // conflicts not resolved yet
+    uint32_t reading;    // random address of the device being identified
+    uint8_t readByte;    // byte of it asked last, 2 for the high byte
+
+    static const uint8_t PIPELINE = DALI_TX_QUEUE_SIZE;
+    struct checkQuery {
+      DaliTransaction transaction;
+      byte address;
+    };
+    checkQuery inFlight[PIPELINE];
+    uint8_t inFlightHead, inFlightTail;
+
+    // searching devices by random address, see DaliClass::commission_tick()
+    byte target;            // short address of the conflict being resolved, 0xFF for devices without short address
+    byte programmed;        // short address programmed last
+    uint32_t searchLow;     // lowest random address a device not yet found can have
+    uint32_t searchPrefix;  // random address bits found so far
+    int8_t searchBit;       // bit currently searched, -1 when all bits are known
+    uint32_t searchAddress; // address to compare with
+    uint32_t searchSent;    // search address last sent to the devices
+    byte searchSentValid;   // bit mask of bytes in searchSent known to the devices (L, M, H)
+    bool searchFound;       // a device responded to compare in current search
+    bool probing;           // compared with the highest address, to find out if there are devices left
+    bool withdraw;          // withdraw the device at searchSent before the next compare
+    bool waiting;           // waiting for random addresses to be generated
+    unsigned long randomised;
+
+    DaliSequence sequence;  // frames of the current step, sent again if they fail
+    DaliTransaction transaction;
+    bool queued;
+    uint8_t retries;
+
+    static const uint8_t MAX_RETRIES = 2;
+
+    void checkTick();
+    void handleCheck(byte address, int result);
+    void handleResult(int result);
+    void send(commissionerStateEnum next);
+    void nextIdentify();
+    void nextTarget();
+    void nextSearch();
+    void searchNextBit();
+    void queueCompare();
+    void program();
+    void addSearchAddress(uint32_t address);
+    byte freeAddress() const;
+    void finish(int result);
+};
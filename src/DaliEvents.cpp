@@ -0,0 +1,113 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliEvents.h"
+
+void DaliEvents::begin() {
+  bus.events = this;
+}
+
+void DaliEvents::end() {
+  if (bus.events == this)
+    bus.events = nullptr;
+}
+
+bool DaliEvents::decode(const daliFrame & frame, daliEvent & event) {
+  // bit 16 set: command to a control device, bits 23, 22 and 15 select the addressing scheme
+  if (frame.error != DALI_NO_ERROR || frame.bits != 24 || (frame.data[0] & 0x01)) return false;
+  uint8_t high = frame.data[0] >> 1 & 0x3F, low = frame.data[1] >> 2 & 0x1F;
+  bool bit15 = frame.data[1] & 0x80;
+  event.timestamp = frame.timestamp;
+  event.device = event.instanceType = event.instance = 0xFF;
+  if ((frame.data[0] & 0x80) == 0) {
+    event.scheme = bit15 ? DALI_EVENT_DEVICE_INSTANCE : DALI_EVENT_DEVICE;
+    event.device = high;
+    (bit15 ? event.instance : event.instanceType) = low;
+  } else if ((frame.data[0] & 0x40) == 0) {
+    if (bit15) return false; // reserved
+    event.scheme = DALI_EVENT_DEVICE_GROUP;
+    event.device = high & 0x1F;
+    event.instanceType = low;
+  } else {
+    event.scheme = bit15 ? DALI_EVENT_INSTANCE_GROUP : DALI_EVENT_INSTANCE;
+    event.instanceType = high & 0x1F;
+    event.instance = low;
+  }
+  event.info = (frame.data[1] & 0x03) << 8 | frame.data[2];
+  return true;
+}
+
+bool DaliEvents::on(uint16_t source, uint16_t info, EventHandlerInputFuncPtr handler, void * context) {
+  uint32_t key = keyOf(source, info);
+  entry * slot = find(key);
+  if (slot == nullptr) {
+    // first removed or empty slot on the probe sequence, one slot stays empty so lookups end
+    uint8_t index = slotOf(key);
+    while (handlers[index].key != EMPTY && handlers[index].key != REMOVED)
+      index = (index + 1) & (DALI_EVENT_HANDLERS - 1);
+    slot = &handlers[index];
+    if (slot->key == EMPTY) {
+      if (used >= DALI_EVENT_HANDLERS - 1) return false;
+      used++;
+    }
+    slot->key = key;
+  }
+  slot->handler = handler;
+  slot->context = context;
+  return true;
+}
+
+void DaliEvents::off(uint16_t source, uint16_t info) {
+  entry * slot = find(keyOf(source, info));
+  if (slot != nullptr)
+    slot->key = REMOVED;
+}
+
+void DaliEvents::clear() {
+  for (uint8_t i = 0; i < DALI_EVENT_HANDLERS; i++)
+    handlers[i].key = EMPTY;
+  used = 0;
+}
+
+void DaliEvents::handle(const daliFrame & frame) {
+  daliEvent event;
+  if (!decode(frame, event)) return;
+  uint16_t source = (frame.data[0] << 6) | (frame.data[1] >> 2);
+  entry * slot = find(keyOf(source, event.info));
+  if (slot == nullptr)
+    slot = find(keyOf(source, ANY));
+  if (slot != nullptr) {
+    dispatched++;
+    slot->handler(event, slot->context);
+  } else {
+    unhandled++;
+    if (unhandledCallback != nullptr)
+      unhandledCallback(event, unhandledContext);
+  }
+}
+
+// Fibonacci hashing, bits 24 and up of the product select the slot
+uint8_t DaliEvents::slotOf(uint32_t key) {
+  return (uint32_t)(key * 2654435769u) >> 24 & (DALI_EVENT_HANDLERS - 1);
+}
+
+DaliEvents::entry * DaliEvents::find(uint32_t key) {
+  for (uint8_t index = slotOf(key); handlers[index].key != EMPTY; index = (index + 1) & (DALI_EVENT_HANDLERS - 1))
+    if (handlers[index].key == key)
+      return &handlers[index];
+  return nullptr;
+}
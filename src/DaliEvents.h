@@ -0,0 +1,160 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliEvents.h
+ * @brief Decoding and dispatch of event messages of input devices
+ *
+ * Input devices (IEC 62386-103) like push buttons, occupancy and light sensors report events as 24 bit forward frames.
+ * DaliEvents decodes them into ::daliEvent records and calls the handler registered for the event source and event
+ * info, found with a hash lookup independent of the number of handlers. Handlers are called from
+ * DaliBusClass::loop(), not from interrupt context.
+ */
+
+#include "DaliBus.h"
+
+#ifndef DALI_EVENT_HANDLERS
+  #define DALI_EVENT_HANDLERS 16
+#endif
+#if DALI_EVENT_HANDLERS < 2 || DALI_EVENT_HANDLERS > 128 || (DALI_EVENT_HANDLERS & (DALI_EVENT_HANDLERS - 1))
+  #error DALI_EVENT_HANDLERS has invalid value (valid values: power of two from 2 to 128)
+#endif
+
+/** Addressing scheme of an event message, see daliEvent::scheme */
+enum daliEventScheme {
+  DALI_EVENT_DEVICE,          /**< short address and instance type */
+  DALI_EVENT_DEVICE_INSTANCE, /**< short address and instance number */
+  DALI_EVENT_DEVICE_GROUP,    /**< device group and instance type */
+  DALI_EVENT_INSTANCE,        /**< instance type and instance number */
+  DALI_EVENT_INSTANCE_GROUP   /**< instance type and instance group */
+};
+
+/** Instance types (IEC 62386-3xx), see daliEvent::instanceType */
+enum daliInstanceType {
+  DALI_INSTANCE_GENERIC = 0,
+  DALI_INSTANCE_PUSH_BUTTON = 1,    /**< part 301 */
+  DALI_INSTANCE_ABSOLUTE_INPUT = 2, /**< part 302, e.g. slider or switch */
+  DALI_INSTANCE_OCCUPANCY = 3,      /**< part 303 */
+  DALI_INSTANCE_LIGHT_SENSOR = 4    /**< part 304, event info is the illuminance */
+};
+
+/** Event info of push buttons (part 301) */
+enum daliButtonEvent {
+  DALI_BUTTON_RELEASED = 0x00,
+  DALI_BUTTON_PRESSED = 0x01,
+  DALI_BUTTON_SHORT_PRESS = 0x02,
+  DALI_BUTTON_DOUBLE_PRESS = 0x05,
+  DALI_BUTTON_LONG_PRESS_START = 0x09,
+  DALI_BUTTON_LONG_PRESS_REPEAT = 0x0B,
+  DALI_BUTTON_LONG_PRESS_STOP = 0x0C,
+  DALI_BUTTON_FREE = 0x0E,
+  DALI_BUTTON_STUCK = 0x0F
+};
+
+/** Event message of an input device, fields not part of the addressing scheme are 0xFF */
+typedef struct daliEvent {
+  unsigned long timestamp;    /**< micros() at the start bit */
+  daliEventScheme scheme;
+  uint8_t device;             /**< short address (0-63) or device group (0-31) */
+  uint8_t instanceType;       /**< ::daliInstanceType */
+  uint8_t instance;           /**< instance number or instance group (0-31) */
+  uint16_t info;              /**< event info (10 bits) */
+} daliEvent;
+
+/** Called from DaliBusClass::loop() for a registered event, see DaliEvents::on() */
+typedef void (*EventHandlerInputFuncPtr)(const daliEvent & event, void * context);
+
+class DaliEvents {
+  public:
+    /** Create dispatcher for @p bus_instance */
+    DaliEvents(DaliBusClass & bus_instance = DaliBus) : bus(bus_instance) { clear(); }
+
+    /** Start dispatching the event messages received on the bus */
+    void begin();
+
+    /** Stop dispatching */
+    void end();
+
+    /** Decode a received frame
+      * @return false if @p frame isn't an event message */
+    static bool decode(const daliFrame & frame, daliEvent & event);
+
+    /** Event sources as sent in bits 23-10 of an event message, for on() */
+    static constexpr uint16_t device(uint8_t address, uint8_t instance_type) {
+      return (address & 0x3F) << 7 | (instance_type & 0x1F);
+    }
+    static constexpr uint16_t deviceInstance(uint8_t address, uint8_t instance_number) {
+      return (address & 0x3F) << 7 | 0x20 | (instance_number & 0x1F);
+    }
+    static constexpr uint16_t deviceGroup(uint8_t group, uint8_t instance_type) {
+      return 0x2000 | (group & 0x1F) << 7 | (instance_type & 0x1F);
+    }
+    static constexpr uint16_t instance(uint8_t instance_type, uint8_t instance_number) {
+      return 0x3000 | (instance_type & 0x1F) << 7 | (instance_number & 0x1F);
+    }
+    static constexpr uint16_t instanceGroup(uint8_t instance_type, uint8_t group) {
+      return 0x3000 | (instance_type & 0x1F) << 7 | 0x20 | (group & 0x1F);
+    }
+
+    static const uint16_t ANY = 0xFFFF; /**< event info matching all events of a source */
+
+    /** Register @p handler for event @p info of @p source, replacing a handler registered for both before. A handler
+      * registered for a specific event info takes precedence over one for ANY of the same source.
+      * @param  source   device(), deviceInstance(), deviceGroup(), instance() or instanceGroup()
+      * @param  info     event info (0-1023) or ANY
+      * @return false if the table is full (#DALI_EVENT_HANDLERS - 1 handlers) */
+    bool on(uint16_t source, uint16_t info, EventHandlerInputFuncPtr handler, void * context = nullptr);
+
+    /** Remove the handler registered for @p info of @p source */
+    void off(uint16_t source, uint16_t info);
+
+    /** Remove all handlers */
+    void clear();
+
+    /** Called for event messages without a handler */
+    EventHandlerInputFuncPtr unhandledCallback = nullptr;
+    void * unhandledContext = nullptr;
+
+    uint32_t dispatched = 0; /**< events passed to a registered handler */
+    uint32_t unhandled = 0;  /**< events without a handler */
+
+    /** Dispatch a received frame, called by the bus */
+    void handle(const daliFrame & frame);
+
+  protected:
+    DaliBusClass & bus;
+
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+    static const uint32_t REMOVED = 0xFFFFFFFE;
+    static const uint32_t ANY_KEY = 0x1000000; // added to the key of handlers for ANY event info
+
+    struct entry {
+      uint32_t key; // source << 10 | info, EMPTY or REMOVED
+      EventHandlerInputFuncPtr handler;
+      void * context;
+    };
+    entry handlers[DALI_EVENT_HANDLERS];
+    uint8_t used = 0; // entries not EMPTY
+
+    static uint32_t keyOf(uint16_t source, uint16_t info) {
+      return info == ANY ? ANY_KEY | (uint32_t)source << 10 : (uint32_t)source << 10 | (info & 0x3FF);
+    }
+    static uint8_t slotOf(uint32_t key);
+    entry * find(uint32_t key);
+};
@@ -0,0 +1,194 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliFaultSearch.h"
+
+static uint8_t countBits(uint64_t value) {
+  uint8_t count = 0;
+  for (; value; value &= value - 1)
+    count++;
+  return count;
+}
+
+void DaliFaultSearch::setGroups(byte address, uint16_t groups) {
+  uint64_t bit = 1ULL << (address & 0x3F);
+  for (uint8_t group = 0; group < 16; group++) {
+    if ((groups >> group) & 1)
+      groupMembers[group] |= bit;
+    else
+      groupMembers[group] &= ~bit;
+  }
+  groupsUnknown &= ~bit;
+}
+
+void DaliFaultSearch::setGroupsUnknown(byte address) {
+  setGroups(address, 0);
+  groupsUnknown |= 1ULL << (address & 0x3F);
+}
+
+void DaliFaultSearch::load(const DaliInventory & inventory) {
+  for (byte i = 0; i < 64; i++) {
+    if (!inventory.isPresent(i))
+      setGroups(i, 0);
+    else if (inventory.incomplete & (1ULL << i))
+      setGroupsUnknown(i);
+    else
+      setGroups(i, inventory.devices[i].groups);
+  }
+}
+
+void DaliFaultSearch::load(const DaliShadow & shadow) {
+  static const uint32_t groupFields = (1UL << SHADOW_GROUPS_0_7) | (1UL << SHADOW_GROUPS_8_15);
+  for (byte i = 0; i < 64; i++) {
+    const daliShadowDevice &dev = shadow.device(i);
+    if (!(dev.valid & (1UL << SHADOW_PRESENT)))
+      setGroups(i, 0);
+    else if ((dev.valid & groupFields) == groupFields)
+      setGroups(i, dev.groups);
+    else
+      setGroupsUnknown(i);
+  }
+}
+
+bool DaliFaultSearch::start(DaliCmd search_query, uint64_t candidates) {
+  if (busy()) return false;
+
+  query = search_query;
+  negative = ~candidates;
+  found = 0;
+  unresolved = 0;
+  frames = 0;
+  retries = 0;
+  pending = false;
+  sets[0].members = candidates;
+  sets[0].positive = false;
+  setCount = candidates ? 1 : 0;
+  return true;
+}
+
+bool DaliFaultSearch::tick() {
+  if (pending) {
+    int result = transaction.result();
+    if (result == DALI_PENDING) return true;
+    pending = false;
+    handleResult(result);
+  }
+  if (!pending)
+    issueNext();
+  return busy();
+}
+
+// choose the query for the last set: the whole set if it isn't known to hold a YES yet and a single frame reaches
+// exactly its members, else the group splitting it most evenly, else its first member. Groups are only used once all
+// devices with unknown groups are ruled out, as a group query might reach any of them.
+void DaliFaultSearch::pick(const faultSet & set, byte & address, byte & addr_type, uint64_t & reached) const {
+  uint64_t members = set.members;
+  bool groupsKnown = (groupsUnknown & ~negative) == 0;
+  addr_type = DaliAddressTypes::GROUP;
+  reached = members;
+  if (!set.positive) {
+    if (members == ~negative) {
+      address = 0xFF;
+      return;
+    }
+    if (groupsKnown)
+      for (address = 0; address < 16; address++)
+        if ((groupMembers[address] & ~negative) == members) return;
+  }
+
+  uint8_t count = countBits(members);
+  uint8_t best = 0;
+  if (groupsKnown && setCount < DALI_FAULT_SETS) { // a YES adds a set
+    for (uint8_t group = 0; group < 16; group++) {
+      uint64_t part = groupMembers[group] & ~negative;
+      if ((part & ~members) != 0) continue; // might be answered by devices outside the set
+      uint8_t size = countBits(part);
+      if (size > count / 2) size = count - size;
+      if (size > best) {
+        best = size;
+        address = group;
+        reached = part;
+      }
+    }
+  }
+  if (best != 0) return;
+
+  addr_type = DaliAddressTypes::SHORT;
+  if (members & groupsUnknown) // these keep the groups from being used
+    members &= groupsUnknown;
+  for (address = 0; !((members >> address) & 1); address++);
+  reached = 1ULL << address;
+}
+
+bool DaliFaultSearch::issueNext() {
+  while (setCount != 0) {
+    faultSet &set = sets[setCount - 1];
+    set.members &= ~negative;
+    if (set.members == 0) {
+      setCount--;
+      continue;
+    }
+    if (set.positive && (set.members & (set.members - 1)) == 0) { // the only one left answers YES
+      found |= set.members;
+      setCount--;
+      continue;
+    }
+
+    byte address, addr_type;
+    uint64_t reached;
+    pick(set, address, addr_type, reached);
+    transaction = dali.sendCmdAsync(address, query, addr_type);
+    if (transaction.result() == DALI_BUSY) return false;
+    asked = reached;
+    pending = true;
+    frames++;
+    return true;
+  }
+  return false;
+}
+
+void DaliFaultSearch::handleResult(int result) {
+  bool answered = result >= 0 || result == DALI_RX_ERROR; // several devices answering at once garble the answer
+  if (!answered && result != DALI_RX_EMPTY) {
+    if (++retries <= MAX_RETRIES) return; // ask again
+    unresolved |= sets[setCount - 1].members;
+    setCount--;
+    retries = 0;
+    return;
+  }
+  retries = 0;
+
+  if (!answered) {
+    negative |= asked;
+    return;
+  }
+  faultSet &set = sets[setCount - 1];
+  if (asked == set.members) {
+    set.positive = true;
+    return;
+  }
+  // the rest of the set may or may not hold another YES
+  set.members &= ~asked;
+  set.positive = false;
+  if ((asked & (asked - 1)) == 0) {
+    found |= asked;
+  } else {
+    sets[setCount].members = asked;
+    sets[setCount].positive = true;
+    setCount++;
+  }
+}
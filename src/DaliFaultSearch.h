@@ -0,0 +1,105 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliFaultSearch.h
+ * @brief Search for the control gear answering YES to a query, e.g. the ones with a lamp failure
+ *
+ * The search asks the query by broadcast first, so on a line without failures it takes a single frame. Any backward
+ * frame counts as YES, also one garbled by several devices answering at once. A set of devices known to hold one that
+ * answers YES is split with the groups the devices are members of, so the devices answering are found with a number of
+ * queries growing with the logarithm of the number of devices. Where no group splits a set any further, its devices
+ * are asked one by one, and the last one is not asked if none of the others answered YES.
+ */
+
+#include "DaliInventory.h"
+#include "DaliShadow.h"
+
+#ifndef DALI_FAULT_SETS
+  #define DALI_FAULT_SETS 8
+#endif
+#if DALI_FAULT_SETS < 2 || DALI_FAULT_SETS > 32
+  #error DALI_FAULT_SETS has invalid value (valid values: 2-32)
+#endif
+
+class DaliFaultSearch {
+  public:
+    /** Create fault search for the bus of @p dali_instance */
+    DaliFaultSearch(DaliClass & dali_instance = Dali) : dali(dali_instance) {}
+
+    /** Start a search, which then needs to be driven by calling tick() from the main loop
+      * @param query       YES/NO query, e.g. QUERY_LAMP_FAILURE, QUERY_CTRL_GEAR_FAIL or QUERY_LIMIT_ERROR
+      * @param candidates  bit per short address that may answer, e.g. DaliInventory::present
+      * @return false if a search is already running */
+    bool start(DaliCmd query = DaliCmd::QUERY_LAMP_FAILURE, uint64_t candidates = ~0ULL);
+
+    /** Advance the search, needs to be called regularly until it returns false
+      * @return true while the search is running */
+    bool tick();
+
+    /** true while a search is running */
+    bool busy() const { return setCount != 0; }
+
+    /** Set the groups of a device, sets of devices are split by them (the groups on the bus aren't changed)
+      * @param address  short address
+      * @param groups   bit per group */
+    void setGroups(byte address, uint16_t groups);
+
+    /** Mark the groups of a device as unknown, it may be member of any group. Such devices are asked one by one before
+      * any group query is sent, so a NO of a group is never taken for a device it may not have reached. */
+    void setGroupsUnknown(byte address);
+
+    /** Take the groups of the devices from a completed inventory scan */
+    void load(const DaliInventory & inventory);
+
+    /** Take the groups of the devices that have answered from the shadow */
+    void load(const DaliShadow & shadow);
+
+    uint64_t groupMembers[16] = {}; /**< bit per short address by group */
+    uint64_t groupsUnknown = 0;     /**< bit per short address whose groups are unknown, see setGroupsUnknown() */
+
+    uint64_t found = 0;      /**< bit per short address that answered YES */
+    uint64_t unresolved = 0; /**< bit per short address whose answer is unknown, because frames failed */
+    uint8_t frames = 0;      /**< queries sent by the last search */
+
+  protected:
+    DaliClass & dali;
+
+    DaliCmd query;
+    uint64_t negative; // addresses known to answer NO, or not to be asked
+
+    // sets of addresses still to search, the last one is searched first
+    struct faultSet {
+      uint64_t members;
+      bool positive; // at least one member answers YES
+    };
+    faultSet sets[DALI_FAULT_SETS];
+    uint8_t setCount = 0;
+
+    DaliTransaction transaction;
+    bool pending = false;
+    uint64_t asked;    // addresses the pending query reaches
+    uint8_t retries;
+
+    static const uint8_t MAX_RETRIES = 2;
+
+    bool issueNext();
+    void handleResult(int result);
+    void pick(const faultSet & set, byte & address, byte & addr_type, uint64_t & reached) const;
+};
@@ -0,0 +1,178 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliInventory.h"
+
+// query for each bit of DaliInventoryField
+static const DaliCmd inventoryQueries[] = {
+  QUERY_DEVICE_TYPE, QUERY_VERSION, QUERY_PHYS_MIN, QUERY_MIN_LEVEL, QUERY_MAX_LEVEL,
+  QUERY_GROUPS_0_7, QUERY_GROUPS_8_15, QUERY_ADDRH, QUERY_ADDRM, QUERY_ADDRL, QUERY_STATUS
+};
+
+bool DaliInventory::start(uint16_t query_fields) {
+  if (busy()) return false;
+
+  fields = query_fields & INVENTORY_ALL;
+  present = 0;
+  incomplete = 0;
+  // the first value queried doubles as presence probe
+  probeField = PROBE_BIT;
+  for (int8_t field = 0; field < PROBE_BIT; field++)
+    if (fields & (1U << field)) {
+      probeField = field;
+      break;
+    }
+  for (byte i = 0; i < 64; i++) {
+    todo[i] = 1U << PROBE_BIT;
+    retries[i] = 0;
+  }
+  broadcastRetries = 0;
+  inFlightHead = inFlightTail = 0;
+  state = INVENTORY_BROADCAST;
+  return true;
+}
+
+uint8_t DaliInventory::count() const {
+  uint8_t result = 0;
+  for (byte i = 0; i < 64; i++)
+    result += isPresent(i);
+  return result;
+}
+
+bool DaliInventory::tick() {
+  if (state == INVENTORY_OFF) return false;
+
+  // results arrive in the order the queries have been queued
+  while (inFlightTail != inFlightHead) {
+    inventoryQuery &query = inFlight[inFlightTail & (PIPELINE - 1)];
+    int result = query.transaction.result();
+    if (result == DALI_PENDING) break;
+    inFlightTail++;
+    handleResult(query, result);
+  }
+  if (state == INVENTORY_OFF) return false;
+
+  // keep the transmit queue filled
+  while ((uint8_t)(inFlightHead - inFlightTail) < PIPELINE && issueNext());
+
+  if (inFlightHead == inFlightTail) {
+    for (byte i = 0; i < 64; i++)
+      if (todo[i]) return true; // transmit queue is full of other frames
+    state = INVENTORY_OFF;
+    return false;
+  }
+  return true;
+}
+
+DaliCmd DaliInventory::probeCommand() const {
+  return probeField == PROBE_BIT ? QUERY_BALLAST : inventoryQueries[probeField];
+}
+
+bool DaliInventory::issue(byte address, int8_t field) {
+  DaliTransaction transaction;
+  if (address == 0xFF)
+    transaction = dali.sendCmdAsync(0xFF, QUERY_BALLAST, DaliAddressTypes::GROUP);
+  else
+    transaction = dali.sendCmdAsync(address, field == PROBE_BIT ? probeCommand() : inventoryQueries[field]);
+  if (transaction.result() == DALI_BUSY) return false;
+
+  inventoryQuery &query = inFlight[inFlightHead & (PIPELINE - 1)];
+  query.transaction = transaction;
+  query.address = address;
+  query.field = field;
+  inFlightHead++;
+  return true;
+}
+
+bool DaliInventory::issueNext() {
+  if (state == INVENTORY_BROADCAST)
+    return inFlightHead == inFlightTail && issue(0xFF, PROBE_BIT);
+
+  // details of found devices first, then probe the next address
+  for (byte i = 0; i < 64; i++) {
+    if (!todo[i]) continue;
+    int8_t field = 0;
+    while (!(todo[i] & (1U << field))) field++;
+    if (!issue(i, field)) return false;
+    todo[i] &= ~(1U << field);
+    return true;
+  }
+  return false;
+}
+
+void DaliInventory::handleResult(const inventoryQuery & query, int result) {
+  bool answered = result >= 0 || result == DALI_RX_ERROR; // garbled answers are still answers
+  bool transmitted = answered || result == DALI_RX_EMPTY;
+
+  if (query.address == 0xFF) {
+    if (!transmitted && ++broadcastRetries <= MAX_RETRIES) return; // send again
+    if (result == DALI_RX_EMPTY) {
+      state = INVENTORY_OFF; // nothing on the bus
+      for (byte i = 0; i < 64; i++)
+        todo[i] = 0;
+    } else {
+      state = INVENTORY_SCAN;
+    }
+    return;
+  }
+
+  byte address = query.address;
+  int8_t field = query.field;
+  if (field == PROBE_BIT) {
+    if (!transmitted) {
+      if (++retries[address] <= MAX_RETRIES) todo[address] |= 1U << PROBE_BIT;
+      return;
+    }
+    if (!answered) return;
+    present |= 1ULL << address;
+    memset(&devices[address], 0, sizeof(daliInventoryEntry));
+    todo[address] = fields;
+    if (probeField == PROBE_BIT) return;
+    field = probeField; // the answer is the first value
+    todo[address] &= ~(1U << field);
+  }
+
+  if (!transmitted || result == DALI_RX_ERROR) {
+    if (++retries[address] <= MAX_RETRIES)
+      todo[address] |= 1U << field;
+    else
+      incomplete |= 1ULL << address;
+    return;
+  }
+
+  if (!answered) { // device doesn't answer this query
+    incomplete |= 1ULL << address;
+    return;
+  }
+
+  daliInventoryEntry &device = devices[address];
+  uint8_t value = result;
+  switch (inventoryQueries[field]) {
+    case QUERY_DEVICE_TYPE: device.deviceType = value; break;
+    case QUERY_VERSION:     device.version = value; break;
+    case QUERY_PHYS_MIN:    device.physMinLevel = value; break;
+    case QUERY_MIN_LEVEL:   device.minLevel = value; break;
+    case QUERY_MAX_LEVEL:   device.maxLevel = value; break;
+    case QUERY_GROUPS_0_7:  device.groups |= value; break;
+    case QUERY_GROUPS_8_15: device.groups |= (uint16_t)value << 8; break;
+    case QUERY_ADDRH:       device.randomAddress |= (uint32_t)value << 16; break;
+    case QUERY_ADDRM:       device.randomAddress |= (uint32_t)value << 8; break;
+    case QUERY_ADDRL:       device.randomAddress |= value; break;
+    case QUERY_STATUS:      device.status = value; break;
+    default: break;
+  }
+}
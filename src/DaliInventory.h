@@ -0,0 +1,107 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliInventory.h
+ * @brief Inventory scan of all control gear on a bus
+ *
+ * The scan checks for any gear with a broadcast query first, then probes the short addresses with the first value to
+ * read and queries the remaining values of each device found. All queries are pipelined through the transmit queue,
+ * so the bus never idles longer than the settling time between frames.
+ */
+
+#include "Dali.h"
+
+/** Values to query per device, see DaliInventory::start() */
+enum DaliInventoryField {
+  INVENTORY_DEVICE_TYPE = 0x001,
+  INVENTORY_VERSION = 0x002,
+  INVENTORY_PHYS_MIN = 0x004,
+  INVENTORY_MIN_LEVEL = 0x008,
+  INVENTORY_MAX_LEVEL = 0x010,
+  INVENTORY_GROUPS = 0x060,         /**< groups 0-7 and 8-15 */
+  INVENTORY_RANDOM_ADDRESS = 0x380, /**< random address H, M and L */
+  INVENTORY_STATUS = 0x400,
+  INVENTORY_ALL = 0x7FF
+};
+
+/** Inventory of a device */
+typedef struct daliInventoryEntry {
+  uint32_t randomAddress;
+  uint16_t groups;
+  uint8_t deviceType; /**< 0xFF if it supports multiple device types */
+  uint8_t version;
+  uint8_t physMinLevel, minLevel, maxLevel;
+  uint8_t status;
+} daliInventoryEntry;
+
+class DaliInventory {
+  public:
+    /** Create inventory for the bus of @p dali_instance */
+    DaliInventory(DaliClass & dali_instance = Dali) : dali(dali_instance) {}
+
+    /** Start a scan, which then needs to be driven by calling tick() from the main loop
+      * @param fields  values to query of each device found, bits of ::DaliInventoryField
+      * @return false if a scan is already running */
+    bool start(uint16_t fields = INVENTORY_ALL);
+
+    /** Advance the scan, needs to be called regularly until it returns false
+      * @return true while the scan is running */
+    bool tick();
+
+    /** true while a scan is running */
+    bool busy() const { return state != INVENTORY_OFF; }
+
+    /** true if @p address (0-63) answered */
+    bool isPresent(byte address) const { return (present >> (address & 0x3F)) & 1; }
+
+    /** Number of devices found */
+    uint8_t count() const;
+
+    uint64_t present = 0;            /**< bit per short address that answered */
+    uint64_t incomplete = 0;         /**< bit per device of which not all values could be read */
+    daliInventoryEntry devices[64];  /**< by short address, valid if present */
+
+  protected:
+    DaliClass & dali;
+
+    enum inventoryStateEnum { INVENTORY_OFF, INVENTORY_BROADCAST, INVENTORY_SCAN };
+    inventoryStateEnum state = INVENTORY_OFF;
+    uint16_t fields;
+    int8_t probeField;     // field queried to probe an address, PROBE_BIT for QUERY_BALLAST
+    uint16_t todo[64];     // fields still to query per device, bit PROBE_BIT if not probed yet
+    uint8_t retries[64];
+    uint8_t broadcastRetries;
+
+    static const int8_t PROBE_BIT = 15;
+    static const uint8_t MAX_RETRIES = 2;
+    static const uint8_t PIPELINE = DALI_TX_QUEUE_SIZE;
+    struct inventoryQuery {
+      DaliTransaction transaction;
+      byte address;
+      int8_t field; // bit number of ::DaliInventoryField or PROBE_BIT
+    };
+    inventoryQuery inFlight[PIPELINE];
+    uint8_t inFlightHead, inFlightTail;
+
+    DaliCmd probeCommand() const;
+    bool issueNext();
+    bool issue(byte address, int8_t field);
+    void handleResult(const inventoryQuery & query, int result);
+};
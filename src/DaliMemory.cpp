@@ -0,0 +1,173 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliMemory.h"
+
+bool DaliMemory::startRead(byte address, byte bank, byte offset, uint8_t * buffer, uint8_t length) {
+  if (!start(MEMORY_READ, address, bank, offset, length)) return false;
+  this->buffer = buffer;
+  return true;
+}
+
+bool DaliMemory::startWrite(byte address, byte bank, byte offset, const uint8_t * data, uint8_t length) {
+  if (!start(MEMORY_WRITE, address, bank, offset, length)) return false;
+  this->data = data;
+  return true;
+}
+
+bool DaliMemory::start(memoryStateEnum transfer, byte address, byte bank, byte offset, uint8_t length) {
+  if (busy() || address > 63 || offset + length > 256) return false;
+
+  this->address = address;
+  this->bank = bank;
+  this->offset = offset;
+  this->length = length;
+  done = 0;
+  retries = 0;
+  resync = true;
+  bankSet = false;
+  inFlightHead = inFlightTail = 0;
+  state = transfer;
+  if (length == 0) finish(0);
+  return true;
+}
+
+bool DaliMemory::tick() {
+  if (state == MEMORY_OFF) return false;
+
+  // results arrive in the order the frames have been queued
+  while (inFlightTail != inFlightHead) {
+    memoryFrame &frame = inFlight[inFlightTail & (PIPELINE - 1)];
+    int result = frame.transaction.result();
+    if (result == DALI_PENDING) break;
+    inFlightTail++;
+    if (!resync) // otherwise it has been queued before an error, its result doesn't count
+      handleResult(frame, result);
+    if (state == MEMORY_OFF) return false;
+  }
+
+  if (done == length && inFlightHead == inFlightTail) {
+    if (state != MEMORY_WRITE) {
+      finish(length);
+      return false;
+    }
+    state = MEMORY_VERIFY;
+    done = 0;
+    retries = 0;
+    resync = true;
+  }
+
+  // the DTRs are set again once all frames queued before have completed
+  if (resync && inFlightHead == inFlightTail) {
+    resync = false;
+    dtrsQueued = false;
+    issued = done;
+  }
+
+  // keep the transmit queue filled
+  while (!resync && (uint8_t)(inFlightHead - inFlightTail) < PIPELINE && issueNext());
+  return true;
+}
+
+bool DaliMemory::issueNext() {
+  DaliSequence sequence(dali);
+  int16_t location = -1;
+  uint8_t changes = dali.bus.dtrChanges();
+  uint8_t bankChanges = dali.bus.dtrChanges(1);
+  // frames of other masters often only write DTR0, DTR1 is then left as it is
+  bool bankHeld = bankSet && bankChanges == bankEpoch;
+  if (!dtrsQueued) {
+    sequence.reuseDtr();
+    if (!bankHeld)
+      sequence.dtr(1, bank);
+    sequence.dtr(0, offset + issued);
+    if (state == MEMORY_WRITE)
+      sequence.cmd(address, DaliCmd::ENABLE_WRITE_MEM);
+  } else {
+    if (issued == length) return false;
+    location = issued;
+    // dropped by the bus if the DTRs may have changed in the meantime
+    sequence.requireDtrs(epoch);
+    if (state == MEMORY_WRITE)
+      sequence.special(DaliSpecialCmd::WRITE_MEM_LOC_NOREPLY, data[location]);
+    else
+      sequence.cmd(address, DaliCmd::READ_MEM_LOC);
+  }
+  DaliTransaction transaction = sequence.send();
+  if (transaction.result() == DALI_BUSY) return false;
+
+  if (location < 0) {
+    dtrsQueued = true;
+    epoch = changes;
+    if (!bankHeld) {
+      bankSet = true;
+      bankEpoch = bankChanges;
+    }
+  } else {
+    issued++;
+  }
+  memoryFrame &frame = inFlight[inFlightHead & (PIPELINE - 1)];
+  frame.transaction = transaction;
+  frame.location = location;
+  inFlightHead++;
+  return true;
+}
+
+void DaliMemory::handleResult(const memoryFrame & frame, int result) {
+  bool answered = result >= 0;
+  if (frame.location < 0 || state == MEMORY_WRITE) {
+    // no answer expected, the frame completes once sent, or with DALI_COLLISION if it collided or has been dropped as
+    // another master sent a frame since the DTRs were set
+    if (result != DALI_RX_EMPTY) {
+      restart(result);
+    } else if (frame.location >= 0) {
+      done = frame.location + 1;
+      retries = 0;
+    }
+    return;
+  }
+
+  if (result == DALI_RX_EMPTY) { // beyond the last accessible location
+    finish(state == MEMORY_VERIFY ? (int)DALI_ERROR_VERIFY : frame.location);
+    return;
+  }
+  if (!answered) {
+    restart(result);
+    return;
+  }
+  if (state == MEMORY_VERIFY && result != data[frame.location]) {
+    finish(DALI_ERROR_VERIFY);
+    return;
+  }
+  if (state == MEMORY_READ)
+    buffer[frame.location] = result;
+  done = frame.location + 1;
+  retries = 0;
+}
+
+void DaliMemory::restart(int error) {
+  if (++retries > MAX_RETRIES) {
+    finish(error);
+    return;
+  }
+  resync = true;
+}
+
+void DaliMemory::finish(int result) {
+  status = result;
+  state = MEMORY_OFF;
+}
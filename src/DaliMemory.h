@@ -0,0 +1,100 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliMemory.h
+ * @brief Reading and writing memory banks of control gear
+ *
+ * DTR1 (bank) and DTR0 (location) are set once, then the locations are streamed with READ MEMORY LOCATION or
+ * WRITE MEMORY LOCATION - NO REPLY, both of which let the gear increment DTR0. All frames are pipelined through the
+ * transmit queue. Each of them is only sent as long as no other master has sent a frame since the DTRs have been set
+ * (see DaliSequence::requireDtrs()), otherwise the transfer continues from the first location not done yet by
+ * setting the DTRs again, DTR0 only if the frames in between left DTR1 alone (see DaliBusClass::dtrChanges(uint8_t)).
+ * The same happens if a frame fails. Writes are verified by reading the locations back.
+ */
+
+#include "Dali.h"
+
+class DaliMemory {
+  public:
+    /** Create memory bank access for the bus of @p dali_instance */
+    DaliMemory(DaliClass & dali_instance = Dali) : dali(dali_instance) {}
+
+    /** Start reading memory bank locations, the transfer then needs to be driven by calling tick() from the main loop
+      * @param address  short address (0-63)
+      * @param bank     memory bank
+      * @param offset   first location
+      * @param buffer   receives the content, needs to stay valid until the transfer is done
+      * @param length   number of locations (offset + length must not exceed 256)
+      * @return false if a transfer is already running or a parameter is invalid */
+    bool startRead(byte address, byte bank, byte offset, uint8_t * buffer, uint8_t length);
+
+    /** Start writing memory bank locations, see startRead()
+      *
+      * Write access is enabled with ENABLE WRITE MEMORY before. Locked banks (lock byte at location 2 not 0x55) and
+      * read-only locations fail verification. */
+    bool startWrite(byte address, byte bank, byte offset, const uint8_t * data, uint8_t length);
+
+    /** Advance the transfer, needs to be called regularly until it returns false
+      * @return true while the transfer is running */
+    bool tick();
+
+    /** true while a transfer is running */
+    bool busy() const { return state != MEMORY_OFF; }
+
+    /** Result of the last transfer
+      * @return number of locations read (less than requested if the bank ends before, the gear doesn't answer
+      *         beyond its last accessible location) or written, DALI_PENDING while running or any of
+      *         ::daliReturnValue on error (DALI_ERROR_VERIFY if a written location reads back differently) */
+    int result() const { return busy() ? (int)DALI_PENDING : status; }
+
+  protected:
+    DaliClass & dali;
+
+    enum memoryStateEnum { MEMORY_OFF, MEMORY_READ, MEMORY_WRITE, MEMORY_VERIFY };
+    memoryStateEnum state = MEMORY_OFF;
+    byte address, bank, offset;
+    uint8_t * buffer;
+    const uint8_t * data;
+    uint8_t length;
+    uint8_t done;          // locations completed
+    uint8_t issued;        // locations queued
+    bool resync;           // set the DTRs again once the frames still queued have completed
+    bool dtrsQueued;       // DTR1, DTR0 (and ENABLE WRITE MEMORY) queued
+    uint8_t epoch;         // DaliBusClass::dtrChanges() when the DTRs were queued
+    bool bankSet;          // DTR1 queued for this transfer
+    uint8_t bankEpoch;     // DaliBusClass::dtrChanges(1) then, DTR1 still holds the bank as long as it returns this
+    uint8_t retries;       // since the last location completed
+    int status = DALI_NO_ERROR;
+
+    static const uint8_t MAX_RETRIES = 2;
+    static const uint8_t PIPELINE = DALI_TX_QUEUE_SIZE;
+    struct memoryFrame {
+      DaliTransaction transaction;
+      int16_t location; // index of the location, -1 for the DTRs
+    };
+    memoryFrame inFlight[PIPELINE];
+    uint8_t inFlightHead, inFlightTail;
+
+    bool start(memoryStateEnum transfer, byte address, byte bank, byte offset, uint8_t length);
+    bool issueNext();
+    void handleResult(const memoryFrame & frame, int result);
+    void restart(int error);
+    void finish(int result);
+};
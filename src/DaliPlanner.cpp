@@ -0,0 +1,162 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliPlanner.h"
+
+// candidates for frames to more than one device: groups 0-15 and broadcast
+static const uint8_t BROADCAST = 16;
+
+static uint8_t countBits(uint64_t value) {
+  uint8_t count = 0;
+  for (; value; value &= value - 1)
+    count++;
+  return count;
+}
+
+void DaliPlanner::clear() {
+  present = 0;
+  known = 0;
+  for (byte i = 0; i < 64; i++)
+    groups[i] = 0;
+}
+
+void DaliPlanner::setDevice(byte address, uint16_t device_groups) {
+  address &= 0x3F;
+  present |= 1ULL << address;
+  known |= 1ULL << address;
+  groups[address] = device_groups;
+}
+
+void DaliPlanner::setDevice(byte address) {
+  address &= 0x3F;
+  present |= 1ULL << address;
+  known &= ~(1ULL << address);
+}
+
+void DaliPlanner::load(const DaliInventory & inventory) {
+  clear();
+  for (byte i = 0; i < 64; i++) {
+    if (!inventory.isPresent(i)) continue;
+    if (inventory.incomplete & (1ULL << i))
+      setDevice(i);
+    else
+      setDevice(i, inventory.devices[i].groups);
+  }
+}
+
+void DaliPlanner::load(const DaliShadow & shadow) {
+  static const uint32_t groupFields = (1UL << SHADOW_GROUPS_0_7) | (1UL << SHADOW_GROUPS_8_15);
+  clear();
+  for (byte i = 0; i < 64; i++) {
+    const daliShadowDevice &dev = shadow.device(i);
+    if (!(dev.valid & (1UL << SHADOW_PRESENT))) continue;
+    if ((dev.valid & groupFields) == groupFields)
+      setDevice(i, dev.groups);
+    else
+      setDevice(i);
+  }
+}
+
+// addresses reached by a group or broadcast frame, including devices that might be group members
+uint64_t DaliPlanner::members(uint8_t candidate) const {
+  if (candidate == BROADCAST) return present;
+  uint64_t result = present & ~known;
+  for (byte i = 0; i < 64; i++)
+    if ((known >> i) & 1 && (groups[i] >> candidate) & 1)
+      result |= 1ULL << i;
+  return result;
+}
+
+uint8_t DaliPlanner::plan(const uint8_t * levels) {
+  uint64_t target = 0; // addresses to set
+  for (byte i = 0; i < 64; i++)
+    if ((present >> i) & 1 && levels[i] != 0xFF)
+      target |= 1ULL << i;
+  uint64_t keep = present & ~target;
+  uint64_t done = 0;   // targets at their level after the frames so far
+  count = 0;
+  sent = 0;
+
+  // greedy: pick the group or broadcast frame that increases the number of devices at their level the most, the
+  // members it moves away from their level are counted against it. Devices with unknown groups get short frames.
+  uint64_t candidates[BROADCAST + 1];
+  for (uint8_t c = 0; c <= BROADCAST; c++)
+    candidates[c] = (members(c) & keep) || (c == BROADCAST && !useBroadcast) ? 0 : members(c) & target & known;
+  while (true) {
+    int8_t bestGain = 1; // a frame for a single device is a short frame
+    uint8_t best = 0;
+    uint64_t bestWant = 0;
+    for (uint8_t c = 0; c <= BROADCAST; c++) {
+      uint64_t reached = candidates[c];
+      uint64_t todo = reached & ~done;
+      while (todo) {
+        uint8_t first = 0;
+        while (!((todo >> first) & 1)) first++;
+        uint64_t want = 0;
+        for (byte i = first; i < 64; i++)
+          if ((reached >> i) & 1 && levels[i] == levels[first])
+            want |= 1ULL << i;
+        todo &= ~want;
+        int8_t gain = countBits(want & ~done) - countBits(reached & done & ~want);
+        if (gain > bestGain) {
+          bestGain = gain;
+          best = c;
+          bestWant = want;
+        }
+      }
+    }
+    if (!bestWant) break;
+
+    uint8_t first = 0;
+    while (!((bestWant >> first) & 1)) first++;
+    frames[count].address = best == BROADCAST ? 0xFE : 0x80 | best << 1;
+    frames[count].level = levels[first];
+    count++;
+    done = (done & ~candidates[best]) | bestWant;
+  }
+
+  for (byte i = 0; i < 64; i++)
+    if ((target & ~done) >> i & 1) {
+      frames[count].address = i << 1;
+      frames[count].level = levels[i];
+      count++;
+    }
+  return count;
+}
+
+bool DaliPlanner::start(const uint8_t * levels) {
+  if (busy()) return false;
+  plan(levels);
+  tick();
+  return true;
+}
+
+bool DaliPlanner::tick() {
+  while (sent < count) {
+    const daliPlanFrame &frame = frames[sent];
+    daliReturnValue result;
+    if (frame.address == 0xFE)
+      result = dali.sendArcBroadcast(frame.level);
+    else if (frame.address & 0x80)
+      result = dali.sendArc((frame.address >> 1) & 0x0F, frame.level, DaliAddressTypes::GROUP);
+    else
+      result = dali.sendArc(frame.address >> 1, frame.level);
+    if (result != DALI_SENT) break;
+    sent++;
+  }
+  return busy();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliPlanner.h
+ * @brief Set many devices to individual levels with as few frames as possible
+ *
+ * From the desired level of each short address and the group memberships of the devices, the planner picks
+ * broadcast and group direct arc power frames that set the most devices at once and sends short address frames only
+ * for the remaining ones. Later frames override earlier ones, so a broadcast with the most common level followed by
+ * a few group and short frames is a typical plan.
+ */
+
+#include "DaliInventory.h"
+#include "DaliShadow.h"
+
+/** Frame of a plan */
+typedef struct daliPlanFrame {
+  byte address; /**< address byte of the frame: 0AAAAAA0 short, 100GGGG0 group or 0xFE broadcast */
+  byte level;
+} daliPlanFrame;
+
+class DaliPlanner {
+  public:
+    /** Create planner for the bus of @p dali_instance */
+    DaliPlanner(DaliClass & dali_instance = Dali) : dali(dali_instance) { clear(); }
+
+    /** Forget all devices */
+    void clear();
+
+    /** Add a device
+      * @param address  short address (0-63)
+      * @param groups   bit per group the device is member of */
+    void setDevice(byte address, uint16_t groups);
+
+    /** Add a device of which the groups are unknown, it only gets short address frames and prevents group frames
+      * while it is to keep its level */
+    void setDevice(byte address);
+
+    /** Take the devices and their groups from a completed inventory scan */
+    void load(const DaliInventory & inventory);
+
+    /** Take the devices that have answered and their groups from the shadow */
+    void load(const DaliShadow & shadow);
+
+    /** Compute the frames to set the levels, see #frames
+      * @param levels  level per short address, 255 (MASK) to keep the current level, ignored for unknown addresses
+      * @return number of frames */
+    uint8_t plan(const uint8_t * levels);
+
+    /** Plan the levels and start sending the frames, which then needs to be driven by calling tick() from the
+      * main loop
+      * @param levels  see plan()
+      * @return false if the frames of the previous plan are still being queued */
+    bool start(const uint8_t * levels);
+
+    /** Queue frames while the transmit queue has room, needs to be called regularly until it returns false
+      * @return true while frames are left to queue */
+    bool tick();
+
+    /** true while frames are left to queue */
+    bool busy() const { return sent < count; }
+
+    /** Allow broadcast frames, these also reach devices without short address */
+    bool useBroadcast = true;
+
+    daliPlanFrame frames[64]; /**< last plan, in order of transmission */
+    uint8_t count = 0;        /**< frames in the last plan */
+
+  protected:
+    DaliClass & dali;
+    uint64_t present;   // bit per known short address
+    uint64_t known;     // bit per address of which the groups are known
+    uint16_t groups[64];
+    uint8_t sent = 0;   // frames of the plan queued
+
+    uint64_t members(uint8_t candidate) const;
+};
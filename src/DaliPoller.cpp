@@ -0,0 +1,116 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliPoller.h"
+
+DaliPoller::DaliPoller(DaliClass & dali_instance) : dali(dali_instance) {
+  static const DaliCmd defaults[] = { DaliCmd::QUERY_STATUS, DaliCmd::QUERY_LAMP_FAILURE, DaliCmd::QUERY_ACTUAL_LEVEL };
+  setQueries(defaults, sizeof(defaults) / sizeof(defaults[0]) < DALI_POLL_QUERIES ?
+                       sizeof(defaults) / sizeof(defaults[0]) : DALI_POLL_QUERIES);
+}
+
+bool DaliPoller::setQueries(const DaliCmd * commands, uint8_t count) {
+  if (count == 0 || count > DALI_POLL_QUERIES) return false;
+  for (uint8_t i = 0; i < count; i++)
+    queries[i] = commands[i];
+  queryCount = count;
+  query = count - 1;
+  clear();
+  return true;
+}
+
+void DaliPoller::clear() {
+  for (uint8_t i = 0; i < DALI_POLL_QUERIES; i++)
+    observed[i] = answered[i] = 0;
+  pending = false; // an answer still outstanding may belong to the queries before
+}
+
+int DaliPoller::value(byte address, DaliCmd command) const {
+  for (uint8_t i = 0; i < queryCount; i++) {
+    if (queries[i] != command) continue;
+    if (!((observed[i] >> (address & 0x3F)) & 1)) return DALI_PENDING;
+    return ((answered[i] >> (address & 0x3F)) & 1) ? values[address & 0x3F][i] : DALI_RX_EMPTY;
+  }
+  return DALI_PENDING;
+}
+
+bool DaliPoller::tick() {
+  if (pending) {
+    if (!transaction.ready()) return true;
+    pending = false;
+    handleResult(transaction.result());
+  }
+  if (addresses == 0) return false;
+
+  unsigned long now = millis();
+  if (interval < minInterval) interval = minInterval;
+  if (now - lastPoll < interval) return true;
+  lastPoll = now;
+
+  // only send when the frame would go out right away, so it doesn't hold up frames queued after it
+  if (!dali.bus.busIsSettled(DALI_PRIORITY_POLL)) {
+    interval = interval + minInterval < maxInterval ? interval + minInterval : maxInterval;
+    deferred++;
+    return true;
+  }
+  interval = interval / 2 > minInterval ? interval / 2 : minInterval;
+
+  advance();
+  daliPriority priority = dali.bus.priority;
+  dali.bus.priority = DALI_PRIORITY_POLL;
+  transaction = dali.sendCmdAsync(address, queries[query]);
+  dali.bus.priority = priority;
+  pending = true;
+  polls++;
+  return true;
+}
+
+// move on to the next query, and to the next address after the last query
+bool DaliPoller::advance() {
+  if (++query < queryCount) return true;
+  query = 0;
+  for (uint8_t i = 0; i < 64; i++) {
+    address = (address + 1) & 0x3F;
+    if ((addresses >> address) & 1) return true;
+  }
+  return false;
+}
+
+void DaliPoller::handleResult(int result) {
+  if (result < 0 && result != DALI_RX_EMPTY) {
+    if (result == DALI_COLLISION) // another master is active
+      interval = interval + minInterval < maxInterval ? interval + minInterval : maxInterval;
+    return; // garbled answer or frame not sent, try again next round
+  }
+
+  uint64_t bit = (uint64_t)1 << address;
+  int previous = (answered[query] & bit) ? values[address][query] : DALI_RX_EMPTY;
+  bool known = observed[query] & bit;
+  observed[query] |= bit;
+  if (result >= 0) {
+    answered[query] |= bit;
+    values[address][query] = result;
+  } else {
+    answered[query] &= ~bit;
+  }
+
+  if (known && result != previous) {
+    changes++;
+    if (changedCallback != nullptr)
+      changedCallback(address, queries[query], result, previous, changedContext);
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliPoller.h
+ * @brief Background polling of control gear in idle bus slots
+ *
+ * The poller sends its queries round-robin to a set of short addresses, one at a time and only while nothing else is
+ * queued and the bus has been idle for the settling time of the lowest priority including its random part
+ * (DaliBusClass::busIsSettled()). Its frames use DALI_PRIORITY_POLL, so other masters go first. Whenever a query is
+ * due but the bus is busy, the time between queries grows by #minInterval, and it halves again, down to
+ * #minInterval, with each query sent on an idle bus. So the busier the bus, the fewer queries. A callback is called
+ * when an answer differs from the one before.
+ */
+
+#include "Dali.h"
+
+#ifndef DALI_POLL_QUERIES
+  #define DALI_POLL_QUERIES 3
+#endif
+#if DALI_POLL_QUERIES < 1 || DALI_POLL_QUERIES > 8
+  #error DALI_POLL_QUERIES has invalid value (valid values: 1-8)
+#endif
+
+/** Called from DaliPoller::tick() when the answer of a device to a query has changed
+  * @param address   short address
+  * @param query     the query
+  * @param value     the answer or DALI_RX_EMPTY if the device didn't answer (e.g. NO to QUERY_LAMP_FAILURE)
+  * @param previous  answer before, also DALI_RX_EMPTY for no answer */
+typedef void (*EventHandlerPollFuncPtr)(byte address, DaliCmd query, int value, int previous, void * context);
+
+class DaliPoller {
+  public:
+    /** Create poller for the bus of @p dali_instance, it queries QUERY_STATUS, QUERY_LAMP_FAILURE and
+      * QUERY_ACTUAL_LEVEL */
+    DaliPoller(DaliClass & dali_instance = Dali);
+
+    /** Set the queries to send to each device, forgets all answers
+      * @return false if @p count is 0 or more than #DALI_POLL_QUERIES */
+    bool setQueries(const DaliCmd * queries, uint8_t count);
+
+    /** Send the next query if it's due and the bus is idle, and handle the answer of the one before. Needs to be
+      * called regularly from the main loop.
+      * @return true while addresses are polled */
+    bool tick();
+
+    /** Last answer of a device
+      * @return the answer, DALI_RX_EMPTY if it didn't answer or DALI_PENDING if it hasn't been queried yet */
+    int value(byte address, DaliCmd query) const;
+
+    /** Forget all answers, so the next ones aren't reported as changes */
+    void clear();
+
+    uint64_t addresses = 0;          /**< bit per short address to poll, e.g. DaliInventory::present */
+    unsigned long minInterval = 100; /**< ms between queries on an idle bus */
+    unsigned long maxInterval = 5000; /**< ms between queries on a busy bus at most */
+
+    EventHandlerPollFuncPtr changedCallback = nullptr;
+    void * changedContext = nullptr;
+
+    uint32_t polls = 0;    /**< queries sent */
+    uint32_t deferred = 0; /**< queries postponed because the bus was busy */
+    uint32_t changes = 0;  /**< answers that differed from the one before */
+
+  protected:
+    DaliClass & dali;
+
+    DaliCmd queries[DALI_POLL_QUERIES];
+    uint8_t queryCount;
+    uint8_t values[64][DALI_POLL_QUERIES];
+    uint64_t observed[DALI_POLL_QUERIES]; // bit per address queried
+    uint64_t answered[DALI_POLL_QUERIES]; // bit per address that answered the last time
+
+    byte address = 63;       // address and index of the query sent last
+    uint8_t query = DALI_POLL_QUERIES - 1;
+    DaliTransaction transaction;
+    bool pending = false;    // transaction of address/query not completed yet
+    unsigned long interval = 0; // current ms between queries
+    unsigned long lastPoll = 0;
+
+    bool advance();
+    void handleResult(int result);
+};
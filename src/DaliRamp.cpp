@@ -0,0 +1,168 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliRamp.h"
+
+// light output of arc power levels 1-254 in 1/65535 of 100%, 10^((n-1)/(253/3)-1) % (IEC 62386-102)
+static const uint16_t arcOutput[254] PROGMEM = {
+  66, 67, 69, 71, 73, 75, 77, 79, 82, 84, 86, 88, 91, 93, 96, 99,
+  101, 104, 107, 110, 113, 116, 119, 123, 126, 130, 133, 137, 141, 145, 149, 153,
+  157, 161, 166, 170, 175, 180, 185, 190, 195, 201, 206, 212, 218, 224, 230, 236,
+  243, 250, 257, 264, 271, 279, 286, 294, 302, 311, 319, 328, 337, 347, 356, 366,
+  376, 387, 397, 408, 420, 431, 443, 455, 468, 481, 494, 508, 522, 536, 551, 567,
+  582, 598, 615, 632, 649, 667, 686, 705, 724, 744, 765, 786, 808, 830, 853, 877,
+  901, 926, 952, 978, 1005, 1033, 1062, 1091, 1121, 1152, 1184, 1217, 1251, 1285, 1321, 1357,
+  1395, 1433, 1473, 1514, 1556, 1599, 1643, 1689, 1735, 1783, 1833, 1884, 1936, 1989, 2044, 2101,
+  2159, 2219, 2280, 2343, 2408, 2475, 2543, 2614, 2686, 2760, 2837, 2915, 2996, 3079, 3164, 3252,
+  3342, 3434, 3529, 3627, 3727, 3831, 3937, 4046, 4158, 4273, 4391, 4513, 4637, 4766, 4898, 5033,
+  5173, 5316, 5463, 5614, 5769, 5929, 6093, 6262, 6435, 6613, 6796, 6985, 7178, 7377, 7581, 7791,
+  8006, 8228, 8456, 8690, 8930, 9177, 9431, 9692, 9961, 10236, 10520, 10811, 11110, 11418, 11734, 12059,
+  12392, 12735, 13088, 13450, 13822, 14205, 14598, 15002, 15418, 15844, 16283, 16734, 17197, 17673, 18162, 18665,
+  19181, 19712, 20258, 20819, 21395, 21987, 22596, 23221, 23864, 24524, 25203, 25901, 26618, 27354, 28112, 28890,
+  29689, 30511, 31356, 32224, 33115, 34032, 34974, 35942, 36937, 37959, 39010, 40090, 41200, 42340, 43512, 44716,
+  45954, 47226, 48533, 49877, 51257, 52676, 54134, 55632, 57172, 58755, 60381, 62052, 63770, 65535
+};
+
+uint16_t DaliRamp::lightOutput(uint8_t level) {
+  return level == 0 ? 0 : pgm_read_word(&arcOutput[level - 1]);
+}
+
+// level with the light output closest to @p output
+uint8_t DaliRamp::levelOf(uint16_t output) {
+  if (output < lightOutput(1) / 2) return 0;
+  uint8_t low = 1, high = 254; // lightOutput(low) <= output unless low is 1
+  while (low < high) {
+    uint8_t middle = (low + high + 1) / 2;
+    if (lightOutput(middle) <= output)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+  if (low < 254 && lightOutput(low + 1) - output < output - lightOutput(low))
+    low++;
+  return low;
+}
+
+uint8_t DaliRamp::level(uint8_t from, uint8_t to, uint16_t progress, daliRampCurve curve) {
+  if (curve == DALI_RAMP_ARC)
+    return from + ((int32_t)(to - from) * progress + (to > from ? 32767 : -32767)) / 65535;
+  int32_t start = lightOutput(from);
+  // the output swings by up to 65535, times the progress that takes more than 32 bits
+  return levelOf(start + ((int64_t)lightOutput(to) - start) * progress / 65535);
+}
+
+bool DaliRamp::start(byte address, uint8_t from, uint8_t to, unsigned long duration, byte addr_type,
+                     daliRampCurve curve) {
+  if (from == 0xFF || to == 0xFF) return false;
+  if (address != 0xFF && address >= (addr_type == DaliAddressTypes::SHORT ? 64 : 16)) return false;
+  ramp * r = find(address, addr_type);
+  if (r == nullptr) {
+    for (uint8_t i = 0; i < DALI_RAMPS && r == nullptr; i++)
+      if (!ramps[i].running)
+        r = &ramps[i];
+    if (r == nullptr) return false;
+    if (active == 0)
+      lastTick = millis();
+    active++;
+  }
+  r->running = true;
+  r->address = address;
+  r->addrType = address == 0xFF ? DaliAddressTypes::GROUP : addr_type;
+  r->from = from;
+  r->to = to;
+  r->sent = 0xFF;
+  r->curve = curve;
+  r->start = millis();
+  r->duration = duration;
+  return true;
+}
+
+void DaliRamp::stop(byte address, byte addr_type) {
+  ramp * r = find(address, addr_type);
+  if (r == nullptr) return;
+  r->running = false;
+  active--;
+}
+
+void DaliRamp::stopAll() {
+  for (uint8_t i = 0; i < DALI_RAMPS; i++)
+    ramps[i].running = false;
+  active = 0;
+}
+
+bool DaliRamp::tick() {
+  unsigned long now = millis();
+  unsigned long elapsed = now - lastTick;
+  lastTick = now;
+  if (active == 0) return false;
+
+  // budget in 1/1000 frames, at most 2 frames can be saved up for later
+  if (elapsed > 2000) elapsed = 2000;
+  uint32_t budget = credit + elapsed * framesPerSecond; // up to 2000 * 255, more than credit holds
+  credit = budget > 2000 ? 2000 : budget;
+
+  // hand the frames to the ramps in turn, a ramp whose level hasn't changed passes its turn on
+  for (uint8_t n = 0; n < DALI_RAMPS && credit >= 1000; n++) {
+    uint8_t index = next;
+    next = (next + 1) % DALI_RAMPS;
+    ramp & r = ramps[index];
+    if (!r.running) continue;
+
+    unsigned long time = now - r.start;
+    bool done = time >= r.duration;
+    uint8_t value = r.to;
+    if (!done) {
+      // scale both to 16 bits, so the progress doesn't overflow
+      unsigned long duration = r.duration;
+      while (duration > 0xFFFF) {
+        duration >>= 1;
+        time >>= 1;
+      }
+      value = level(r.from, r.to, time * 0xFFFF / duration, (daliRampCurve)r.curve);
+    }
+    if (value == r.sent) {
+      if (done) {
+        r.running = false;
+        active--;
+      } else {
+        stepsSkipped++;
+      }
+      continue;
+    }
+
+    if (dali.sendArc(r.address, value, r.addrType) != DALI_SENT) {
+      next = index; // transmit queue full, try again with the same ramp
+      break;
+    }
+    r.sent = value;
+    credit -= 1000;
+    framesSent++;
+    if (done) {
+      r.running = false;
+      active--;
+    }
+  }
+  return active != 0;
+}
+
+DaliRamp::ramp * DaliRamp::find(byte address, byte addr_type) {
+  if (address == 0xFF) addr_type = DaliAddressTypes::GROUP;
+  for (uint8_t i = 0; i < DALI_RAMPS; i++)
+    if (ramps[i].running && ramps[i].address == address && ramps[i].addrType == addr_type)
+      return &ramps[i];
+  return nullptr;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliRamp.h
+ * @brief Software ramps of arc power levels within a frame budget
+ *
+ * Ramps of any duration and curve run concurrently on short addresses, groups or broadcast. The levels are sent as
+ * direct arc power frames, at most #framesPerSecond of them for all ramps together, handed out to the ramps in turn.
+ * A ramp only gets a frame when its level has changed since the last one it sent, so slow ramps use few frames and
+ * the bandwidth goes to those that need it. Each ramp ends with its target level.
+ */
+
+#include "Dali.h"
+
+#ifndef DALI_RAMPS
+  #define DALI_RAMPS 8
+#endif
+#if DALI_RAMPS < 1 || DALI_RAMPS > 64
+  #error DALI_RAMPS has invalid value (valid values: 1-64)
+#endif
+
+/** Interpolation of a ramp */
+enum daliRampCurve {
+  DALI_RAMP_ARC,  /**< linear in arc power levels, i.e. logarithmic in light output like fades of the control gear */
+  DALI_RAMP_LIGHT /**< linear in light output, levels are looked up in a table of the standard dimming curve */
+};
+
+class DaliRamp {
+  public:
+    /** Create ramp engine for the bus of @p dali_instance */
+    DaliRamp(DaliClass & dali_instance = Dali) : dali(dali_instance) { stopAll(); }
+
+    /** Start a ramp, replacing a ramp running on the same address
+      * @param  address    short address (0-63), group (0-15) or 0xFF for broadcast
+      * @param  from       level at the start (0-254)
+      * @param  to         level at the end (0-254)
+      * @param  duration   ms
+      * @param  addr_type  ::DaliAddressTypes
+      * @param  curve      interpolation
+      * @return false if all #DALI_RAMPS ramps are running or a parameter is invalid */
+    bool start(byte address, uint8_t from, uint8_t to, unsigned long duration,
+               byte addr_type = DaliAddressTypes::SHORT, daliRampCurve curve = DALI_RAMP_LIGHT);
+
+    /** Stop the ramp of an address where it is */
+    void stop(byte address, byte addr_type = DaliAddressTypes::SHORT);
+
+    /** Stop all ramps */
+    void stopAll();
+
+    /** Send the next levels as far as the budget allows, needs to be called regularly from the main loop
+      * @return true while ramps are running */
+    bool tick();
+
+    /** true while ramps are running */
+    bool busy() const { return active != 0; }
+
+    /** Level of a point of a ramp
+      * @param  progress  0 (@p from) to 65535 (@p to) */
+    static uint8_t level(uint8_t from, uint8_t to, uint16_t progress, daliRampCurve curve);
+
+    /** Frames per second for all ramps together. The bus carries about 32 frames/s, so the default leaves room for
+      * other traffic. */
+    uint8_t framesPerSecond = 20;
+
+    uint32_t framesSent = 0;   /**< levels sent */
+    uint32_t stepsSkipped = 0; /**< turns passed on because the level hasn't changed */
+
+  protected:
+    DaliClass & dali;
+
+    struct ramp {
+      bool running;
+      byte address, addrType;
+      uint8_t from, to, sent;  // sent: last level sent, 0xFF before the first one
+      uint8_t curve;           // ::daliRampCurve
+      unsigned long start, duration;
+    };
+    ramp ramps[DALI_RAMPS];
+    uint8_t active = 0;        // ramps running
+    uint8_t next = 0;          // ramp whose turn it is
+    uint16_t credit = 0;       // frames that may be sent, in 1/1000
+    unsigned long lastTick = 0;
+
+    ramp * find(byte address, byte addr_type);
+    static uint16_t lightOutput(uint8_t level);
+    static uint8_t levelOf(uint16_t output);
+};
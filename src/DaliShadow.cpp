@@ -0,0 +1,441 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliShadow.h"
+
+const unsigned long DALI_REPEAT_TIME = 100000; // µs within which configuration commands need to be repeated
+const unsigned long DALI_ANSWER_TIME = 30000;  // µs from the start of a query to the start of its backward frame
+
+#define SHADOW_BIT(field) ((uint32_t)1 << (field))
+#define SHADOW_CONFIG (~(SHADOW_BIT(SHADOW_LEVEL) | SHADOW_BIT(SHADOW_STATUS) | SHADOW_BIT(SHADOW_PRESENT)))
+
+void DaliShadow::begin() {
+  dali.setMonitor(monitor, this);
+}
+
+void DaliShadow::clear(byte address) {
+  if (address == 0xFF) {
+    for (byte i = 0; i < 64; i++)
+      devices[i].valid = 0;
+    dtrValid = false;
+  } else {
+    devices[address & 0x3F].valid = 0;
+  }
+}
+
+int DaliShadow::query(byte address, DaliCmd command, byte timeout) {
+  uint8_t value;
+  if (get(address, command, value)) {
+    hits++;
+    return value;
+  }
+  misses++;
+
+  unsigned long time = millis();
+  DaliTransaction transaction;
+  while ((transaction = dali.sendCmdAsync(address, command)).result() == DALI_BUSY)
+    if (millis() - time > timeout) return DALI_READY_TIMEOUT;
+  int response = transaction.wait(timeout);
+
+  // the monitor sees the frame as well, but only once it has been dispatched from loop()
+  handleResponse((address << 9) | 0x100 | command, response);
+  return response;
+}
+
+bool DaliShadow::get(byte address, DaliCmd command, uint8_t & value) {
+  int8_t field = fieldOf(command);
+  if (address > 63 || field < 0) return false;
+  flushPending();
+
+  daliShadowDevice &dev = devices[address];
+  if (!isFresh(dev, field)) return false;
+
+  switch (command) {
+    case QUERY_STATUS:         value = dev.status; break;
+    case QUERY_ACTUAL_LEVEL:   value = dev.actualLevel; break;
+    case QUERY_MAX_LEVEL:      value = dev.maxLevel; break;
+    case QUERY_MIN_LEVEL:      value = dev.minLevel; break;
+    case QUERY_PHYS_MIN:       value = dev.physMinLevel; break;
+    case QUERY_POWER_ON_LEVEL: value = dev.powerOnLevel; break;
+    case QUERY_FAIL_LEVEL:     value = dev.failLevel; break;
+    case QUERY_FADE_SPEEDS:    value = dev.fadeSpeeds; break;
+    case QUERY_GROUPS_0_7:     value = dev.groups & 0xFF; break;
+    case QUERY_GROUPS_8_15:    value = dev.groups >> 8; break;
+    default:                   value = dev.scenes[command - QUERY_SCENE_LEVEL]; break;
+  }
+  return true;
+}
+
+// value field of a query, -1 if not shadowed
+int8_t DaliShadow::fieldOf(byte command) {
+  switch (command) {
+    case QUERY_STATUS:         return SHADOW_STATUS;
+    case QUERY_ACTUAL_LEVEL:   return SHADOW_LEVEL;
+    case QUERY_MAX_LEVEL:      return SHADOW_MAX;
+    case QUERY_MIN_LEVEL:      return SHADOW_MIN;
+    case QUERY_PHYS_MIN:       return SHADOW_PHYS_MIN;
+    case QUERY_POWER_ON_LEVEL: return SHADOW_POWER_ON;
+    case QUERY_FAIL_LEVEL:     return SHADOW_FAIL;
+    case QUERY_FADE_SPEEDS:    return SHADOW_FADE;
+    case QUERY_GROUPS_0_7:     return SHADOW_GROUPS_0_7;
+    case QUERY_GROUPS_8_15:    return SHADOW_GROUPS_8_15;
+  }
+  if (command >= QUERY_SCENE_LEVEL && command < QUERY_SCENE_LEVEL + 16)
+    return SHADOW_SCENE + (command - QUERY_SCENE_LEVEL);
+  return -1;
+}
+
+bool DaliShadow::isFresh(const daliShadowDevice & dev, int8_t field) const {
+  if (!(dev.valid & SHADOW_BIT(field))) return false;
+  if (field == SHADOW_LEVEL) return millis() - dev.levelTime <= levelMaxAge;
+  if (field == SHADOW_STATUS) return millis() - dev.statusTime <= levelMaxAge;
+  return configMaxAge == 0 || millis() - dev.configTime <= configMaxAge;
+}
+
+void DaliShadow::monitor(const daliFrame & frame, int response, void * context) {
+  DaliShadow * shadow = (DaliShadow *)context;
+
+  if (response != DALI_PENDING) { // own frame
+    shadow->queryPending = false;
+    if (frame.bits != 16) return;
+    if (response < 0 && response != DALI_RX_EMPTY && response != DALI_RX_ERROR) return; // not transmitted
+    uint16_t forward = (frame.data[0] << 8) | frame.data[1];
+    shadow->handleFrame(forward, frame.timestamp);
+    shadow->handleResponse(forward, response);
+    return;
+  }
+
+  if (frame.error != DALI_NO_ERROR) {
+    // might have been anything, e.g. colliding backward frames or a command that changed levels
+    shadow->queryPending = false;
+    for (byte i = 0; i < 64; i++)
+      shadow->devices[i].valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+    return;
+  }
+
+  switch (frame.bits) {
+    case 16:
+      shadow->handleFrame((frame.data[0] << 8) | frame.data[1], frame.timestamp);
+      shadow->queryPending = true;
+      break;
+    case 8:
+      if (shadow->queryPending && frame.timestamp - shadow->lastFrameTime <= DALI_ANSWER_TIME)
+        shadow->handleResponse(shadow->lastFrame, frame.data[0]);
+      shadow->queryPending = false;
+      break;
+  }
+}
+
+// store response of a query sent to a single device
+void DaliShadow::handleResponse(uint16_t frame, int response) {
+  byte address = frame >> 8;
+  byte command = frame & 0xFF;
+  if ((address & 0x81) != 0x01) return; // no command to a short address
+  daliShadowDevice &dev = devices[address >> 1];
+
+  int8_t field = fieldOf(command);
+  if (response == DALI_RX_EMPTY) {
+    if (field >= 0) dev.valid = 0; // device doesn't exist (anymore)
+    return;
+  }
+  if (response < 0) return;
+
+  dev.valid |= SHADOW_BIT(SHADOW_PRESENT);
+  if (field < 0) return;
+  uint8_t value = response;
+  switch (command) {
+    case QUERY_STATUS:         dev.status = value; break;
+    case QUERY_ACTUAL_LEVEL:   dev.actualLevel = value; break;
+    case QUERY_MAX_LEVEL:      dev.maxLevel = value; break;
+    case QUERY_MIN_LEVEL:      dev.minLevel = value; break;
+    case QUERY_PHYS_MIN:       dev.physMinLevel = value; break;
+    case QUERY_POWER_ON_LEVEL: dev.powerOnLevel = value; break;
+    case QUERY_FAIL_LEVEL:     dev.failLevel = value; break;
+    case QUERY_FADE_SPEEDS:    dev.fadeSpeeds = value; break;
+    case QUERY_GROUPS_0_7:     dev.groups = (dev.groups & 0xFF00) | value; break;
+    case QUERY_GROUPS_8_15:    dev.groups = (dev.groups & 0x00FF) | (value << 8); break;
+    default:                   dev.scenes[command - QUERY_SCENE_LEVEL] = value; break;
+  }
+  dev.valid |= SHADOW_BIT(field);
+  if (field == SHADOW_LEVEL) dev.levelTime = millis();
+  else if (field == SHADOW_STATUS) dev.statusTime = millis();
+  else dev.configTime = millis();
+}
+
+void DaliShadow::handleFrame(uint16_t frame, unsigned long time) {
+  byte address = frame >> 8;
+  byte command = frame & 0xFF;
+
+  if (configPending) {
+    configPending = false;
+    if (frame == lastFrame && time - lastFrameTime <= DALI_REPEAT_TIME) {
+      apply(frame, true);
+      lastFrame = ~frame; // a third copy is a new command
+      lastFrameTime = time;
+      return;
+    }
+    apply(lastFrame, false); // not repeated, the device may or may not have executed it
+  }
+  lastFrame = frame;
+  lastFrameTime = time;
+
+  if ((address & 0xE1) == 0xA1 || (address & 0xE1) == 0xC1) { // special command
+    switch (address) {
+      case 0xA3: // SET_DTR
+        dtr = command;
+        dtrValid = true;
+        break;
+      case 0xA5: // INITIALISE, short addresses are about to change
+        clear();
+        break;
+      case 0xB7: // PROGRAMSHORT
+        if (command != 0xFF) clear((command >> 1) & 0x3F);
+        break;
+    }
+    return;
+  }
+
+  if (!(address & 0x01) || command < 32 || command > 129)
+    apply(frame, true);
+  else
+    configPending = true; // configuration commands need to be received twice
+}
+
+void DaliShadow::flushPending() {
+  if (configPending && micros() - lastFrameTime > DALI_REPEAT_TIME) {
+    configPending = false;
+    apply(lastFrame, false);
+  }
+}
+
+// values that may be changed by a command
+uint32_t DaliShadow::affects(bool arc, byte command) {
+  const uint32_t level = SHADOW_BIT(SHADOW_LEVEL) | SHADOW_BIT(SHADOW_STATUS);
+  if (arc) return level;
+  if (command < 32) return (command <= 10 || command >= GO_TO_SCENE) ? level : 0;
+  switch (command) {
+    case DEVICE_RESET:     return ~SHADOW_BIT(SHADOW_PRESENT) & ~SHADOW_BIT(SHADOW_PHYS_MIN);
+    case DTR_AS_MAX:       return level | SHADOW_BIT(SHADOW_MAX);
+    case DTR_AS_MIN:       return level | SHADOW_BIT(SHADOW_MIN);
+    case DTR_AS_FAIL:      return SHADOW_BIT(SHADOW_FAIL);
+    case DTR_AS_POWER_ON:  return SHADOW_BIT(SHADOW_POWER_ON);
+    case DTR_AS_FADE_TIME:
+    case DTR_AS_FADE_RATE: return SHADOW_BIT(SHADOW_FADE);
+    case DTR_AS_SHORT:     return ~(uint32_t)0;
+  }
+  if (command >= DTR_AS_SCENE && command < ADD_TO_GROUP)
+    return SHADOW_BIT(SHADOW_SCENE + (command & 0x0F));
+  if (command >= ADD_TO_GROUP && command < DTR_AS_SHORT)
+    return SHADOW_BIT((command & 0x08) ? SHADOW_GROUPS_8_15 : SHADOW_GROUPS_0_7);
+  return 0;
+}
+
+// apply forward frame to all addressed devices, or forget what it may have changed if not @p confirmed
+void DaliShadow::apply(uint16_t frame, bool confirmed) {
+  byte address = frame >> 8;
+  byte command = frame & 0xFF;
+  bool arc = !(address & 0x01);
+
+  if (!arc && command == ARC_TO_DTR) {
+    dtrValid = false;
+    if (confirmed && !(address & 0x80)) {
+      daliShadowDevice &dev = devices[address >> 1];
+      if (isFresh(dev, SHADOW_LEVEL)) {
+        dtr = dev.actualLevel;
+        dtrValid = true;
+      }
+    }
+    return;
+  }
+
+  uint32_t mask = affects(arc, command);
+  if (mask == 0) return;
+  if (address == 0xFC || address == 0xFD) { // broadcast unaddressed, only reaches gear without a short address
+    if (!arc && command == DTR_AS_SHORT) { // which may take the address in DTR
+      if (!dtrValid) clear();
+      else if (dtr != 0xFF) clear((dtr >> 1) & 0x3F);
+    }
+    return;
+  }
+
+  for (byte i = 0; i < 64; i++) {
+    daliShadowDevice &dev = devices[i];
+    bool certain = confirmed && (dev.valid & SHADOW_BIT(SHADOW_PRESENT));
+
+    if (!(address & 0x80)) { // short address
+      if ((address >> 1) != i) continue;
+    } else if ((address & 0xE0) == 0x80) { // group address
+      uint32_t groupsValid = SHADOW_BIT(SHADOW_GROUPS_0_7) | SHADOW_BIT(SHADOW_GROUPS_8_15);
+      if ((dev.valid & groupsValid) == groupsValid) {
+        if (!(dev.groups & (1 << ((address >> 1) & 0x0F)))) continue;
+      } else {
+        certain = false; // membership unknown
+      }
+    } else if (address < 0xFE) { // reserved
+      return;
+    }
+
+    if (!arc && command == DTR_AS_SHORT) {
+      // device moves to the address in DTR (or loses its address)
+      dev.valid = 0;
+      if (!dtrValid) clear();
+      else if (dtr != 0xFF) clear((dtr >> 1) & 0x3F);
+    } else if (certain) {
+      applyCommand(dev, arc, command);
+    } else {
+      dev.valid &= ~mask;
+    }
+  }
+}
+
+void DaliShadow::setLevel(daliShadowDevice & dev, uint8_t level) {
+  if (level == 0xFF) return; // MASK, no change
+  if (level != 0) {
+    uint32_t limits = SHADOW_BIT(SHADOW_MIN) | SHADOW_BIT(SHADOW_MAX);
+    if ((dev.valid & limits) != limits) {
+      dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+      return;
+    }
+    if (level < dev.minLevel) level = dev.minLevel;
+    if (level > dev.maxLevel) level = dev.maxLevel;
+  }
+  dev.actualLevel = level;
+  dev.valid |= SHADOW_BIT(SHADOW_LEVEL);
+  dev.levelTime = millis();
+}
+
+// execute command on the shadow of a device that is known to be addressed
+void DaliShadow::applyCommand(daliShadowDevice & dev, bool arc, byte command) {
+  dev.valid &= ~SHADOW_BIT(SHADOW_STATUS);
+  if (arc) {
+    setLevel(dev, command);
+    return;
+  }
+
+  bool levelKnown = isFresh(dev, SHADOW_LEVEL);
+  uint8_t level = dev.actualLevel;
+  if (command >= GO_TO_SCENE && command < GO_TO_SCENE + 16) {
+    if (dev.valid & SHADOW_BIT(SHADOW_SCENE + (command & 0x0F)))
+      setLevel(dev, dev.scenes[command & 0x0F]);
+    else
+      dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+    return;
+  }
+
+  bool dtrNeeded = (command >= DTR_AS_MAX && command <= DTR_AS_FADE_RATE) ||
+                   (command >= DTR_AS_SCENE && command < REMOVE_FROM_SCENE);
+  if (dtrNeeded && !dtrValid) {
+    dev.valid &= ~affects(false, command);
+    return;
+  }
+
+  if (command >= DEVICE_RESET) dev.configTime = millis();
+  switch (command) {
+    case OFF:
+      setLevel(dev, 0);
+      break;
+    case RECALL_MAX:
+      if (dev.valid & SHADOW_BIT(SHADOW_MAX)) setLevel(dev, dev.maxLevel);
+      else dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+      break;
+    case RECALL_MIN:
+      if (dev.valid & SHADOW_BIT(SHADOW_MIN)) setLevel(dev, dev.minLevel);
+      else dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+      break;
+    case STEP_UP:
+      if (levelKnown && level != 0) setLevel(dev, level < 254 ? level + 1 : level);
+      else if (!levelKnown) dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+      break;
+    case STEP_DOWN:
+      if (levelKnown && level != 0) setLevel(dev, level > dev.minLevel ? level - 1 : level);
+      else if (!levelKnown) dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+      break;
+    case STEP_DOWN_AND_OFF:
+      if (levelKnown && (dev.valid & SHADOW_BIT(SHADOW_MIN)))
+        setLevel(dev, level <= dev.minLevel ? 0 : level - 1);
+      else
+        dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+      break;
+    case ON_AND_STEP_UP:
+      if (levelKnown && (dev.valid & SHADOW_BIT(SHADOW_MIN)))
+        setLevel(dev, level == 0 ? dev.minLevel : (level < 254 ? level + 1 : level));
+      else
+        dev.valid &= ~SHADOW_BIT(SHADOW_LEVEL);
+      break;
+
+    case DEVICE_RESET:
+      dev.maxLevel = 254;
+      dev.minLevel = dev.physMinLevel;
+      dev.powerOnLevel = 254;
+      dev.failLevel = 254;
+      dev.fadeSpeeds = 0x07;
+      dev.groups = 0;
+      for (byte i = 0; i < 16; i++)
+        dev.scenes[i] = 0xFF;
+      dev.valid |= SHADOW_CONFIG & ~SHADOW_BIT(SHADOW_MIN);
+      if (dev.valid & SHADOW_BIT(SHADOW_PHYS_MIN)) dev.valid |= SHADOW_BIT(SHADOW_MIN);
+      setLevel(dev, 254);
+      break;
+
+    case DTR_AS_MAX:
+      if (dev.valid & SHADOW_BIT(SHADOW_MIN)) {
+        dev.maxLevel = dtr < dev.minLevel ? dev.minLevel : (dtr > 254 ? 254 : dtr);
+        if (levelKnown && level > dev.maxLevel) setLevel(dev, dev.maxLevel);
+      } else {
+        dev.valid &= ~SHADOW_BIT(SHADOW_MAX);
+      }
+      break;
+    case DTR_AS_MIN:
+      if ((dev.valid & SHADOW_BIT(SHADOW_PHYS_MIN)) && (dev.valid & SHADOW_BIT(SHADOW_MAX))) {
+        dev.minLevel = dtr < dev.physMinLevel ? dev.physMinLevel : (dtr > dev.maxLevel ? dev.maxLevel : dtr);
+        if (levelKnown && level != 0 && level < dev.minLevel) setLevel(dev, dev.minLevel);
+      } else {
+        dev.valid &= ~SHADOW_BIT(SHADOW_MIN);
+      }
+      break;
+    case DTR_AS_FAIL:
+      dev.failLevel = dtr;
+      dev.valid |= SHADOW_BIT(SHADOW_FAIL);
+      break;
+    case DTR_AS_POWER_ON:
+      dev.powerOnLevel = dtr;
+      dev.valid |= SHADOW_BIT(SHADOW_POWER_ON);
+      break;
+    case DTR_AS_FADE_TIME:
+      dev.fadeSpeeds = (dev.fadeSpeeds & 0x0F) | ((dtr > 15 ? 15 : dtr) << 4);
+      break;
+    case DTR_AS_FADE_RATE:
+      dev.fadeSpeeds = (dev.fadeSpeeds & 0xF0) | (dtr > 15 ? 15 : (dtr == 0 ? 1 : dtr));
+      break;
+
+    default:
+      if (command >= DTR_AS_SCENE && command < REMOVE_FROM_SCENE) {
+        dev.scenes[command & 0x0F] = dtr;
+        dev.valid |= SHADOW_BIT(SHADOW_SCENE + (command & 0x0F));
+      } else if (command >= REMOVE_FROM_SCENE && command < ADD_TO_GROUP) {
+        dev.scenes[command & 0x0F] = 0xFF;
+        dev.valid |= SHADOW_BIT(SHADOW_SCENE + (command & 0x0F));
+      } else if (command >= ADD_TO_GROUP && command < REMOVE_FROM_GROUP) {
+        dev.groups |= 1 << (command & 0x0F);
+      } else if (command >= REMOVE_FROM_GROUP && command < DTR_AS_SHORT) {
+        dev.groups &= ~(1 << (command & 0x0F));
+      } else {
+        dev.valid &= ~affects(false, command); // UP, DOWN, GO_TO_LAST
+      }
+      break;
+  }
+}
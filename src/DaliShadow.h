@@ -0,0 +1,108 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliShadow.h
+ * @brief Cached state of the control gear on a bus
+ *
+ * The shadow follows all traffic on the bus (own frames, their responses and frames of other masters) and keeps
+ * the last known state of each short address, so queries can be answered without a bus round trip.
+ * It needs about 2.5 kB of RAM and Dali.loop() to be called regularly.
+ */
+
+#include "Dali.h"
+
+/** Shadowed values of a device, bit numbers in daliShadowDevice::valid */
+enum DaliShadowField {
+  SHADOW_LEVEL = 0, SHADOW_STATUS = 1,
+  SHADOW_MIN = 2, SHADOW_MAX = 3, SHADOW_PHYS_MIN = 4, SHADOW_POWER_ON = 5, SHADOW_FAIL = 6, SHADOW_FADE = 7,
+  SHADOW_GROUPS_0_7 = 8, SHADOW_GROUPS_8_15 = 9,
+  SHADOW_PRESENT = 15, /**< device has answered */
+  SHADOW_SCENE = 16    /**< 16 bits, one per scene */
+};
+
+/** Last known state of a device */
+typedef struct daliShadowDevice {
+  uint8_t actualLevel;   /**< target level of the last arc power command, doesn't follow fading */
+  uint8_t status;
+  uint8_t minLevel, maxLevel, physMinLevel, powerOnLevel, failLevel;
+  uint8_t fadeSpeeds;    /**< fade time (high nibble) and fade rate (low nibble) */
+  uint16_t groups;
+  uint8_t scenes[16];
+  uint32_t valid;        /**< bit per ::DaliShadowField */
+  unsigned long levelTime;  /**< millis() of the last update of the level */
+  unsigned long statusTime; /**< millis() of the last update of the status */
+  unsigned long configTime; /**< millis() of the last update of any other value */
+} daliShadowDevice;
+
+class DaliShadow {
+  public:
+    /** Create shadow for the bus of @p dali_instance */
+    DaliShadow(DaliClass & dali_instance = Dali) : dali(dali_instance) { clear(); }
+
+    /** Start following the bus, installs the monitor callback (see DaliClass::setMonitor()) */
+    void begin();
+
+    /** Answer a query from the shadow if possible, otherwise send it and wait for the response
+      * @param  address  short address
+      * @param  command  QUERY_STATUS, QUERY_ACTUAL_LEVEL, QUERY_MAX_LEVEL, QUERY_MIN_LEVEL, QUERY_PHYS_MIN,
+      *                  QUERY_POWER_ON_LEVEL, QUERY_FAIL_LEVEL, QUERY_FADE_SPEEDS, QUERY_SCENE_LEVEL + n,
+      *                  QUERY_GROUPS_0_7 or QUERY_GROUPS_8_15, other queries are always sent
+      * @param  timeout  time in ms to wait for the response
+      * @return the response, DALI_RX_EMPTY or any of ::daliReturnValue on error, see DaliClass::sendCmdWait() */
+    int query(byte address, DaliCmd command, byte timeout = 50);
+
+    /** Get a fresh value from the shadow without using the bus
+      * @return false if the value is unknown or older than #levelMaxAge / #configMaxAge */
+    bool get(byte address, DaliCmd command, uint8_t & value);
+
+    /** Raw state of a short address (0-63) */
+    const daliShadowDevice & device(byte address) const { return devices[address & 0x3F]; }
+
+    /** Forget the state of @p address, or of all devices for 0xFF */
+    void clear(byte address = 0xFF);
+
+    unsigned long levelMaxAge = 5000; /**< ms after which level and status are queried again */
+    unsigned long configMaxAge = 0;   /**< same for all other values, 0 to keep them until they are changed */
+
+    uint32_t hits = 0;   /**< queries answered from the shadow */
+    uint32_t misses = 0; /**< queries sent to the bus */
+
+  protected:
+    DaliClass & dali;
+    daliShadowDevice devices[64];
+
+    uint8_t dtr;
+    bool dtrValid = false;
+    uint16_t lastFrame = 0;         // last forward frame, to detect repeated configuration commands
+    unsigned long lastFrameTime = 0; // micros()
+    bool configPending = false;     // lastFrame is a configuration command that hasn't been repeated yet
+    bool queryPending = false;      // lastFrame is a sniffed query that a backward frame may answer
+
+    static void monitor(const daliFrame & frame, int response, void * context);
+    void handleFrame(uint16_t frame, unsigned long time);
+    void handleResponse(uint16_t frame, int response);
+    void flushPending();
+    void apply(uint16_t frame, bool confirmed);
+    void applyCommand(daliShadowDevice & dev, bool arc, byte command);
+    void setLevel(daliShadowDevice & dev, uint8_t level);
+    static uint32_t affects(bool arc, byte command);
+    static int8_t fieldOf(byte command);
+    bool isFresh(const daliShadowDevice & dev, int8_t field) const;
+};
@@ -0,0 +1,81 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301  USA
+*/
+
+#include "DaliTrace.h"
+
+void DaliTrace::begin() {
+  static const uint8_t magic[3] = { 'D', 'L', 'T' };
+  record(DALI_TRACE_START, micros(), 0, magic);
+  bus.trace = this;
+}
+
+void DaliTrace::end() {
+  if (bus.trace == this)
+    bus.trace = nullptr;
+}
+
+bool DaliTrace::read(daliTraceRecord & record) {
+  // a record write() has started streaming is left for write() to complete, the one after it is taken instead
+  uint8_t started = writeOffset != 0;
+  if ((uint8_t)(head - tail) <= started) return false;
+  daliTraceRecord & next = records[(tail + started) & (DALI_TRACE_SIZE - 1)];
+  record = next;
+  if (started)
+    next = records[tail & (DALI_TRACE_SIZE - 1)]; // moves up to the new tail
+  tail++;
+  return true;
+}
+
+uint8_t DaliTrace::write(Print & out) {
+  uint8_t count = 0;
+  while (head != tail) {
+    // write the contiguous part of the ring at once, continuing a record cut off by a short write before
+    uint8_t index = tail & (DALI_TRACE_SIZE - 1);
+    uint8_t length = head - tail;
+    if (length > DALI_TRACE_SIZE - index)
+      length = DALI_TRACE_SIZE - index;
+    size_t size = length * sizeof(daliTraceRecord);
+    size_t written = writeOffset + out.write((const uint8_t *)&records[index] + writeOffset, size - writeOffset);
+    uint8_t complete = written / sizeof(daliTraceRecord);
+    writeOffset = written % sizeof(daliTraceRecord);
+    tail += complete;
+    count += complete;
+    if (written < size) break; // target can't take more now, the rest goes out with the next call
+  }
+  return count;
+}
+
+void DaliTrace::record(daliTraceType type, unsigned long timestamp, uint8_t bits, const uint8_t * data) {
+  // report lost records as soon as there is room again, keeping one slot for the record itself
+  if (pendingDropped != 0 && (uint8_t)(head - tail) < DALI_TRACE_SIZE - 1) {
+    uint8_t count[3] = { (uint8_t)(pendingDropped >> 16), (uint8_t)(pendingDropped >> 8), (uint8_t)pendingDropped };
+    pendingDropped = 0;
+    record(DALI_TRACE_DROPPED, timestamp, 0, count);
+  }
+  if ((uint8_t)(head - tail) >= DALI_TRACE_SIZE || pendingDropped != 0) {
+    dropped++;
+    pendingDropped++;
+    return;
+  }
+
+  daliTraceRecord & entry = records[head & (DALI_TRACE_SIZE - 1)];
+  entry.timestamp = timestamp;
+  entry.type = (type << 5) | (bits & 0x1F);
+  for (byte i = 0; i < 3; i++)
+    entry.data[i] = data[i];
+  head++;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+/***********************************************************************
+ * This library is free software; you can redistribute it and/or       *
+ * modify it under the terms of the GNU Lesser General Public          *
+ * License as published by the Free Software Foundation; either        *
+ * version 2.1 of the License, or (at your option) any later version.  *
+ *                                                                     *
+ * This library is distributed in the hope that it will be useful,     *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of      *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   *
+ * Lesser General Public License for more details.                     *
+ *                                                                     *
+ * You should have received a copy of the GNU Lesser General Public    *
+ * License along with this library; if not, write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          *
+ * MA 02110-1301  USA                                                  *
+ ***********************************************************************/
+
+/**
+ * @file DaliTrace.h
+ * @brief Binary trace of all frames on a bus
+ *
+ * The recorder logs own frames, their responses, frames of other participants and errors as fixed 8 byte records.
+ * Records are buffered until streamed out unformatted, e.g. over Serial, and can be decoded and replayed offline
+ * with extras/host/dali_trace.
+ */
+
+#include "DaliBus.h"
+
+#ifndef DALI_TRACE_SIZE
+  #define DALI_TRACE_SIZE 64
+#endif
+#if DALI_TRACE_SIZE < 2 || DALI_TRACE_SIZE > 128 || (DALI_TRACE_SIZE & (DALI_TRACE_SIZE - 1))
+  #error DALI_TRACE_SIZE has invalid value (valid values: power of two from 2 to 128)
+#endif
+
+/** Type of a trace record, see daliTraceRecord::type */
+enum daliTraceType {
+  DALI_TRACE_START = 0,    /**< recording started, data is "DLT" */
+  DALI_TRACE_SENT = 1,     /**< own forward frame, timestamp of the start bit */
+  DALI_TRACE_RESPONSE = 2, /**< backward frame to the previous own frame, timestamp of its last edge */
+  DALI_TRACE_RECEIVED = 3, /**< frame of another participant, timestamp of the start bit */
+  DALI_TRACE_ERROR = 4,    /**< data[0] is the negated ::daliReturnValue, data[1] 1 for own frames, data[2] the bits received */
+  DALI_TRACE_DROPPED = 5   /**< records lost because the buffer was full, data is the count (big endian) */
+};
+
+/** Trace record, stored and streamed as is (little endian on all supported platforms) */
+typedef struct daliTraceRecord {
+  uint32_t timestamp; /**< micros() */
+  uint8_t type;       /**< ::daliTraceType in bits 7-5, number of bits of the frame in bits 4-0 */
+  uint8_t data[3];    /**< frame as in daliFrame::data */
+} daliTraceRecord;
+
+class DaliTrace {
+  public:
+    /** Create recorder for @p bus_instance */
+    DaliTrace(DaliBusClass & bus_instance = DaliBus) : bus(bus_instance) {}
+
+    /** Start recording, records are added from DaliBusClass::loop() and the other functions called from the main loop */
+    void begin();
+
+    /** Stop recording */
+    void end();
+
+    /** Number of records buffered */
+    uint8_t available() const { return head - tail; }
+
+    /** Take the oldest record from the buffer, except one write() has streamed only partly, which stays for write()
+      * @return false if the buffer is empty */
+    bool read(daliTraceRecord & record);
+
+    /** Stream all buffered records to @p out without formatting. If @p out takes fewer bytes, the rest stays buffered
+      * and the next call continues where this one stopped, also within a record.
+      * @return number of records written completely */
+    uint8_t write(Print & out);
+
+    /** Add a record, called by the bus */
+    void record(daliTraceType type, unsigned long timestamp, uint8_t bits, const uint8_t * data);
+
+    uint32_t dropped = 0; /**< records lost in total */
+
+  protected:
+    DaliBusClass & bus;
+    daliTraceRecord records[DALI_TRACE_SIZE];
+    uint8_t head = 0;
+    uint8_t tail = 0;
+    uint8_t writeOffset = 0;     // bytes of the record at tail already written by write()
+    uint32_t pendingDropped = 0; // not reported with a DALI_TRACE_DROPPED record yet
+};